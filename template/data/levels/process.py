@@ -2,9 +2,6 @@ from os import listdir
 from os.path import dirname, abspath, isfile, join
 import json
 
-from PIL import Image
-from PIL import ImageFilter
-
 from math import sqrt, copysign
 
 def line_len(x1, y1, x2, y2):
@@ -133,25 +130,6 @@ def convert(filepath):
         file.write(json.dumps(j))
         file.close()
 
-        sizex *= 64
-        sizey *= 64
-
-        print("    Loading bricks")
-
-        brickimage = Image.new("RGB", (sizex, sizey), color = (255, 255, 255))
-        brickpixels = brickimage.load()
-
-        for b in bricks:
-            startx = 64 * b["pos"]["x"]
-            starty = 64 * b["pos"]["y"]
-            for i in range(startx, startx + 64):
-                for j in range(starty, starty + 64):
-                    colour = b["colour"]
-                    if colour["r"] == 1.0 and colour["g"] == 1.0 and colour["b"] == 1.0:
-                        brickpixels[i, j] = (0, 0, 0)
-
-        brickimage.save("".join([dirpath, "/shadow/", filename + "_brickmap.bmp"]))
-
 def convertall():
     path = dirname(abspath(__file__))
     for f in listdir(path):
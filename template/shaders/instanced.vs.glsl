@@ -0,0 +1,27 @@
+#version 330 
+
+// Input attributes
+in vec3 in_position;
+in vec2 in_texcoord;
+
+// Per instance attributes
+in vec2 in_offset;
+in vec4 in_colour;
+
+// Passed to fragment shader
+out vec2 texcoord;
+flat out vec4 colour;
+
+// Application data
+uniform mat3 transform;
+uniform mat3 projection;
+uniform vec2 sprite_size;
+uniform vec4 texture_rect; // xy: offset, zw: scale of the sprite inside its texture
+
+void main()
+{
+	texcoord = texture_rect.xy + in_texcoord * texture_rect.zw;
+	colour = in_colour;
+	vec3 pos = projection * (transform * vec3(in_position.xy * sprite_size, 1.0) + vec3(in_offset, 0.0));
+	gl_Position = vec4(pos.xy, in_position.z, 1.0);
+}
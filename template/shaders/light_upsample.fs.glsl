@@ -0,0 +1,62 @@
+#version 330
+
+uniform sampler2D screen_texture;
+uniform sampler2D brick_map; // one texel per brick, set where white bricks block light
+uniform sampler2D light_terms; // reduced resolution lighting, x: intensity, y: headlight channel mix
+
+uniform vec3 headlight_channel;
+uniform vec2 camera_pos;
+
+in vec2 uv;
+layout(location = 0) out vec4 color;
+
+vec2 screen_size;
+
+const float BRICK_SIZE = 64;
+
+// Whether the fragment at frag (window coordinates) lies on a brick, computed like pos in light.fs.glsl
+bool on_brick(vec2 frag)
+{
+	vec2 coord = (frag / screen_size * 2 - 1 + 1.05) / 2.1;
+	vec2 pos = vec2(coord.x * screen_size.x, (1 - coord.y) * screen_size.y);
+	ivec2 brick = ivec2(floor((pos - camera_pos + vec2(32, 32)) / BRICK_SIZE));
+	if (any(lessThan(brick, ivec2(0, 0))) || any(greaterThanEqual(brick, textureSize(brick_map, 0))))
+	{
+		return false;
+	}
+	return texelFetch(brick_map, brick, 0).x > 0.5;
+}
+
+void main()
+{
+	screen_size = textureSize(screen_texture, 0);
+	vec2 terms_size = textureSize(light_terms, 0);
+	vec2 scale = screen_size / terms_size;
+
+	// Bilinear blend of the four closest lighting texels, except texels on the other side of a brick edge
+	// barely count so light does not bleed into walls or out of them
+	vec2 t = gl_FragCoord.xy / scale - 0.5;
+	vec2 base = floor(t);
+	vec2 f = t - base;
+	bool brick = on_brick(gl_FragCoord.xy);
+
+	vec2 terms = vec2(0, 0);
+	float weight_sum = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		vec2 offset = vec2(i & 1, i >> 1);
+		vec2 texel = clamp(base + offset, vec2(0, 0), terms_size - 1);
+		float weight = mix(1 - f.x, f.x, offset.x) * mix(1 - f.y, f.y, offset.y) + 0.0001;
+		if (on_brick((texel + 0.5) * scale) != brick)
+		{
+			weight = weight * 0.01;
+		}
+
+		terms += texelFetch(light_terms, ivec2(texel), 0).xy * weight;
+		weight_sum += weight;
+	}
+	terms = terms / weight_sum;
+
+	vec4 in_color = texture(screen_texture, uv);
+	color = mix(in_color, vec4(headlight_channel, 1.0), terms.y) * terms.x;
+}
@@ -0,0 +1,43 @@
+#version 330
+
+uniform sampler2D distance_field; // signed distance in pixels to the nearest occluder
+uniform float distance_field_texel; // pixels covered by one distance_field texel
+uniform vec2 light_position; // world space
+uniform float light_range;
+
+// Distance from the light to the first occluder in the direction of this texel
+layout(location = 0) out float occluder;
+
+const float PI = 3.14159265;
+const float SHADOW_MAP_ANGLES = 1024; // width of the shadow map in light.cpp
+const int MAX_TRACE_STEPS = 128;
+const float MIN_TRACE_STEP = 2;
+
+float get_distance_at_pixel(vec2 pixel)
+{
+	vec2 field_coord = pixel + vec2(32, 32);
+	field_coord = field_coord / (textureSize(distance_field, 0) * distance_field_texel);
+	return texture(distance_field, field_coord).x;
+}
+
+void main()
+{
+	// Texels sweep the angles from -PI to PI
+	float angle = (gl_FragCoord.x / SHADOW_MAP_ANGLES - 0.5) * 2 * PI;
+	vec2 d = vec2(cos(angle), sin(angle));
+
+	// Sphere traced, each step jumps to the nearest occluder
+	float t = 0;
+	for (int i = 0; i < MAX_TRACE_STEPS && t < light_range; i++)
+	{
+		float clearance = get_distance_at_pixel(light_position + t * d);
+		if (clearance <= 0)
+		{
+			break;
+		}
+
+		t = t + max(clearance, MIN_TRACE_STEP);
+	}
+
+	occluder = min(t, light_range);
+}
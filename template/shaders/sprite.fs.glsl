@@ -0,0 +1,26 @@
+#version 330
+
+// From vertex shader
+in vec2 texcoord;
+flat in vec4 colour;
+
+// Application data
+uniform sampler2D sampler0;
+uniform vec3 headlight_channel;
+
+// Output color
+layout(location = 0) out  vec4 color;
+
+// Compiled once per sprite variant:
+//   COLOUR_HIDEABLE  sprites not lit by the headlight colour fade out
+void main()
+{
+	vec4 tex = texture(sampler0, vec2(texcoord.x, texcoord.y));
+#ifdef COLOUR_HIDEABLE
+	if (colour.rgb != headlight_channel) {
+		color = vec4(colour.rgb, 0.1) * tex;
+		return;
+	}
+#endif
+	color = colour * tex;
+}
@@ -1,19 +1,21 @@
 #version 330 
 
-// Input attributes
-in vec3 in_position;
+// Input attributes, positions are transformed into world space when the sprite is batched
+in vec2 in_position;
 in vec2 in_texcoord;
+in vec4 in_colour;
 
 // Passed to fragment shader
 out vec2 texcoord;
+flat out vec4 colour;
 
 // Application data
-uniform mat3 transform;
 uniform mat3 projection;
 
 void main()
 {
 	texcoord = in_texcoord;
-	vec3 pos = projection * transform * vec3(in_position.xy, 1.0);
-	gl_Position = vec4(pos.xy, in_position.z, 1.0);
-}
\ No newline at end of file
+	colour = in_colour;
+	vec3 pos = projection * vec3(in_position, 1.0);
+	gl_Position = vec4(pos.xy, -0.01, 1.0);
+}
@@ -27,6 +27,7 @@ bool Door::init(int id, vec2 position)
 
     if (!rc.init_sprite())
         return false;
+    rc.is_static = true;
 
     if (!Interactable::init(id, position))
         return false;
@@ -56,25 +57,21 @@ vec2 Door::get_position()
 	return mc.position;
 }
 
-Hitbox Door::get_hitbox() const
+const Hitbox& Door::get_hitbox() const
 {
     return m_hitbox;
 }
 
 void Door::calculate_hitbox()
 {
-    std::vector<Square> squares(2);
-
     float width = brick_size;
     vec2 position = mc.position;
     position.x -= width / 2 + 60;
     position.y += width / 2;
     Square top(position, (int)width);
     Square bot(add(position, {0.f, width}), (int)width);
-    squares[0] = top;
-    squares[1] = bot;
 
-    Hitbox hitbox({}, squares);
+    Hitbox hitbox({}, {top, bot});
     m_hitbox = hitbox;
 }
 
@@ -18,7 +18,7 @@ class Door: public Interactable
 
 		vec2 get_position();
 
-        Hitbox get_hitbox() const;
+        const Hitbox& get_hitbox() const;
 
         std::string perform_action();
 
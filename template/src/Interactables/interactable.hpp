@@ -19,7 +19,7 @@ protected:
 public:
     bool init(int id, vec2 position);
 
-    virtual Hitbox get_hitbox() const = 0;
+    virtual const Hitbox& get_hitbox() const = 0;
 
     // perform_action is abstract, as implementation is dependent on child classes
     virtual std::string perform_action() = 0;
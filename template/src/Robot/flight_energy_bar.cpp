@@ -68,6 +68,7 @@ bool FlightEnergyBar::init(int id)
     if (!rc.init_sprite()) {
         return false;
     }
+    rc.layer = Layer::actors;
 
 	s_render_components[id] = &rc;
 	s_motion_components[id] = &mc;
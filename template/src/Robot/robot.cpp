@@ -41,6 +41,7 @@ bool Robot::init(int id, bool use_parts)
 
 	if (!rc.init_sprite())
 		return false;
+	rc.layer = Layer::actors;
 
     mc.position = { 0.f, 0.f };
     mc.velocity = { 0.f, 0.f };
@@ -217,26 +218,23 @@ void Robot::set_energy_bar_position(vec2 position) {
     m_energy_bar.set_position(position);
 }
 
-Hitbox Robot::get_hitbox()
+const Hitbox& Robot::get_hitbox() const
 {
     return m_hitbox;
 }
 
 void Robot::calculate_hitbox()
 {
-    std::vector<Circle> circles(1);
-
     vec2 position = mc.position;
 
     int radius = (int)brick_size / 2;
     Circle circle(position, radius);
-    circles[0] = circle;
 
-    Hitbox hitbox(circles, {});
+    Hitbox hitbox({circle}, {});
 	m_hitbox = hitbox;
 }
 
-Hitbox Robot::get_head_hitbox()
+const Hitbox& Robot::get_head_hitbox() const
 {
     return m_head.get_hitbox();
 }
@@ -72,10 +72,10 @@ public:
     void set_energy_bar_position(vec2 position);
 
 	// Returns the robots hitbox for collision detection
-	Hitbox get_hitbox();
+	const Hitbox& get_hitbox() const;
 
     // Returns the robots head hitbox for collision detection
-    Hitbox get_head_hitbox();
+    const Hitbox& get_head_hitbox() const;
 
 	// Starts smoke system and changes to flying sprite
 	void start_flying();
@@ -19,6 +19,7 @@ bool RobotHead::init(int id)
 
     if (!rc.init_sprite())
         return false;
+    rc.layer = Layer::actors;
 
     mc.position = { 0.f, 0.f };
     mc.velocity = { 0.f, 0.f };
@@ -47,7 +48,7 @@ void RobotHead::update(float ms, vec2 goal)
 	}
 }
 
-Hitbox RobotHead::get_hitbox()
+const Hitbox& RobotHead::get_hitbox() const
 {
     return m_hitbox;
 }
@@ -98,14 +99,11 @@ void RobotHead::set_velocity(vec2 velocity) {
 }
 
 void RobotHead::calculate_hitbox() {
-    std::vector<Circle> circles(1);
-
     vec2 position = mc.position;
 
     int radius = rc.texture->height/2;
     Circle circle(position, radius);
-    circles[0] = circle;
 
-    Hitbox hitbox(circles, {});
+    Hitbox hitbox({circle}, {});
     m_hitbox = hitbox;
 }
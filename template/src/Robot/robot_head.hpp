@@ -23,7 +23,7 @@ public:
     void update(float ms, vec2 goal);
 
     // Returns the robots hitbox for collision detection
-    Hitbox get_hitbox();
+    const Hitbox& get_hitbox() const;
 
     // Returns the current robot position
     vec2 get_position() const;
@@ -19,6 +19,7 @@ bool RobotShoulders::init(int id)
 
     if (!rc.init_sprite())
         return false;
+    rc.layer = Layer::actors;
 
     mc.position = { 0.f, 0.f };
     mc.velocity = { 0.f, 0.f };
@@ -1,5 +1,6 @@
 #include "menu.hpp"
 #include "sound_system.hpp"
+#include "gl_debug.hpp"
 
 bool Menu::init(GLFWwindow* window, vec2 screen)
 {
@@ -8,7 +9,7 @@ bool Menu::init(GLFWwindow* window, vec2 screen)
 	// Create a frame buffer
 	m_frame_buffer = 0;
 	glGenFramebuffers(1, &m_frame_buffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, m_frame_buffer);
+	gl_bind_framebuffer(GL_FRAMEBUFFER, m_frame_buffer);
 
 	int fb_width, fb_height;
 	glfwGetFramebufferSize(m_window, &fb_width, &fb_height);
@@ -92,7 +93,7 @@ void Menu::draw()
 
 	/////////////////////
 	// Render to the screen
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	gl_bind_framebuffer(GL_FRAMEBUFFER, 0);
 
 	// Clearing backbuffer
 	glViewport(0, 0, w, h);
@@ -22,6 +22,10 @@ bool Background::init(int id, float scale, float alpha)
 	if (!rc_first.init_sprite() || !rc_second.init_sprite() || !rc_third.init_sprite())
 		return false;
 
+	rc_first.layer = Layer::background;
+	rc_second.layer = Layer::background;
+	rc_third.layer = Layer::background;
+
 	mc_first.position = { 0.f, 0.f };
 	mc_first.physics.scale = { scale , scale };
 
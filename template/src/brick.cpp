@@ -28,6 +28,12 @@ bool Brick::init(int id, vec3 colour)
         brc.texture = &brick_texture;
         irc.texture = &brick_texture;
 
+        // The shader variant is picked from these when the sprite is initialised
+        rrc.can_be_hidden = 1;
+        grc.can_be_hidden = 1;
+        brc.can_be_hidden = 1;
+        irc.is_invisible = 1;
+
 		if (!rc.init_sprite())
 			return false;
 
@@ -42,6 +48,25 @@ bool Brick::init(int id, vec3 colour)
 
         if (!irc.init_sprite())
             return false;
+
+        // Every brick shares the tile texture, so they are all drawn in one instanced call
+        rc.instanced = true;
+        rrc.instanced = true;
+        grc.instanced = true;
+        brc.instanced = true;
+        irc.instanced = true;
+
+        rc.layer = Layer::bricks;
+        rrc.layer = Layer::bricks;
+        grc.layer = Layer::bricks;
+        brc.layer = Layer::bricks;
+        irc.layer = Layer::bricks;
+
+        rc.is_static = true;
+        rrc.is_static = true;
+        grc.is_static = true;
+        brc.is_static = true;
+        irc.is_static = true;
 	}
 
 	mc.position = { 0.f, 0.f };
@@ -56,19 +81,15 @@ bool Brick::init(int id, vec3 colour)
             || (m_colour.x == 0.f && m_colour.y == 0.f && m_colour.z == 0.f);
 
     if (colour.x == 1.f && colour.y == 0.f && colour.z == 0.f) {
-        rrc.can_be_hidden = 1;
         rrc.colour = m_colour;
         s_render_components[id] = &rrc;
     } else if (colour.x == 0.f && colour.y == 1.f && colour.z == 0.f) {
-        grc.can_be_hidden = 1;
         grc.colour = m_colour;
         s_render_components[id] = &grc;
     } else if (colour.x == 0.f && colour.y == 0.f && colour.z == 1.f) {
-        brc.can_be_hidden = 1;
         brc.colour = m_colour;
         s_render_components[id] = &brc;
     } else if (colour.x == 0.f && colour.y == 0.f && colour.z == 0.f) {
-        irc.is_invisible = 1;
         irc.colour = m_colour;
         s_render_components[id] = &irc;
     } else {
@@ -103,18 +124,16 @@ void Brick::set_position(vec2 position)
 
 void Brick::calculate_hitbox()
 {
-    std::vector<Square> squares(1);
     float width = brick_size;
     vec2 position = mc.position;
     position.x -= width / 2;
     position.y += width / 2;
     Square square(position, (int)width);
-    squares[0] = square;
-    Hitbox hitbox({}, squares);
+    Hitbox hitbox({}, {square});
     m_hitbox = hitbox;
 }
 
-Hitbox Brick::get_hitbox() const
+const Hitbox& Brick::get_hitbox() const
 {
     return m_hitbox;
 }
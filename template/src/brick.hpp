@@ -30,7 +30,7 @@ public:
 	void set_position(vec2 position);
 
 	// Returns the bricks hitbox for collision detection
-	Hitbox get_hitbox() const;
+	const Hitbox& get_hitbox() const;
 
     bool get_is_collidable();
 
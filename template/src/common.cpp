@@ -1,4 +1,5 @@
 #include "common.hpp"
+#include "gl_debug.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "../ext/stb_image/stb_image.h"
@@ -8,14 +9,25 @@
 #include <iostream>
 #include <sstream>
 #include <cmath>
+#include <algorithm>
+#include <tuple>
+#include <string>
+#include <unordered_map>
 
 void gl_flush_errors()
 {
+	if (gl_debug_output_enabled())
+		return;
+
 	while (glGetError() != GL_NO_ERROR);
 }
 
 bool gl_has_errors()
 {
+	// Errors are reported by the debug output callback as they happen, glGetError would only stall the pipeline
+	if (gl_debug_output_enabled())
+		return false;
+
 	GLenum error = glGetError();
 
 	if (error == GL_NO_ERROR) return false;
@@ -60,6 +72,8 @@ float dot(vec3 l, vec3 r)
 }
 
 double scroll_sensitivity = 1.f;
+int lighting_downscale = 1;
+bool cpu_lighting = false;
 
 vec2 add(vec2 a, vec2 b) { return { a.x+b.x, a.y+b.y }; }
 vec2 sub(vec2 a, vec2 b) { return { a.x-b.x, a.y-b.y }; }
@@ -109,40 +123,113 @@ vec2 normalize(vec2 v)
 	return { v.x / m, v.y / m };
 }
 
-float get_closest_point(float last_pos, float tile_pos, float circle_width, float tile_width)
+bool within_range(float val, float low, float high)
 {
-	float side = 1.f;
-	if (last_pos < tile_pos)
-		side = -1.f;
-
-	float ret = tile_pos + side * (circle_width + tile_width + 1.f);
-
-	if (std::abs(last_pos - ret) < 1.f)
-		return last_pos;
-	else
-		return ret;
+	return (val - high)*(val - low) <= 0;
 }
 
-bool within_range(float val, float low, float high)
+namespace
 {
-	return (val - high)*(val - low) <= 0;
+	// Atlas pages are filled shelf by shelf as textures are loaded and live until the program exits. Each image
+	// is packed once, later loads of its path reuse its region.
+	const int ATLAS_PAGE_SIZE = 2048;
+	const int ATLAS_MAX_IMAGE_SIZE = 512;
+	const int ATLAS_PADDING = 1; // border texels copied from the image edge so linear filtering never reads a neighbour
+
+	struct AtlasPage
+	{
+		GLuint id;
+		int shelf_x;
+		int shelf_y;
+		int shelf_height;
+	};
+
+	std::vector<AtlasPage> s_atlas_pages;
+
+	struct AtlasRegion
+	{
+		GLuint id;
+		int width;
+		int height;
+		vec2 uv_offset;
+		vec2 uv_scale;
+	};
+
+	std::unordered_map<std::string, AtlasRegion> s_atlas_regions;
+
+	// Finds room for a w x h block, opening a new page when no existing one has space
+	AtlasPage* atlas_allocate(int w, int h, int& x, int& y)
+	{
+		for (auto& page : s_atlas_pages)
+		{
+			if (page.shelf_x + w > ATLAS_PAGE_SIZE)
+			{
+				page.shelf_x = 0;
+				page.shelf_y += page.shelf_height;
+				page.shelf_height = 0;
+			}
+			if (page.shelf_y + h > ATLAS_PAGE_SIZE)
+				continue;
+
+			x = page.shelf_x;
+			y = page.shelf_y;
+			page.shelf_x += w;
+			page.shelf_height = std::max(page.shelf_height, h);
+			return &page;
+		}
+
+		AtlasPage page = { 0, 0, 0, 0 };
+		glGenTextures(1, &page.id);
+		glBindTexture(GL_TEXTURE_2D, page.id);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		s_atlas_pages.push_back(page);
+
+		x = 0;
+		y = 0;
+		s_atlas_pages.back().shelf_x = w;
+		s_atlas_pages.back().shelf_height = h;
+		return &s_atlas_pages.back();
+	}
 }
 
-Texture::Texture() 
+Texture::Texture() :
+	id(0), depth_render_buffer_id(0), width(0), height(0),
+	uv_offset{ 0.f, 0.f }, uv_scale{ 1.f, 1.f }, in_atlas(false)
 {
 
 }
 
 Texture::~Texture()
 {
-	if (id != 0) glDeleteTextures(1, &id);
+	if (id != 0 && !in_atlas) glDeleteTextures(1, &id);
 	if (depth_render_buffer_id != 0) glDeleteRenderbuffers(1, &depth_render_buffer_id);
 }
 
-bool Texture::load_from_file(const char* path)
+bool Texture::load_from_file(const char* path, bool pack)
 {
 	if (path == nullptr) 
 		return false;
+
+	if (pack)
+	{
+		auto packed = s_atlas_regions.find(path);
+		if (packed != s_atlas_regions.end())
+		{
+			const AtlasRegion& region = packed->second;
+			id = region.id;
+			width = region.width;
+			height = region.height;
+			uv_offset = region.uv_offset;
+			uv_scale = region.uv_scale;
+			in_atlas = true;
+			depth_render_buffer_id = 0;
+			return true;
+		}
+	}
 	
 	stbi_uc* data = stbi_load(path, &width, &height, NULL, 4);
 	depth_render_buffer_id = 0;
@@ -150,6 +237,40 @@ bool Texture::load_from_file(const char* path)
 		return false;
 
 	gl_flush_errors();
+
+	if (pack && width <= ATLAS_MAX_IMAGE_SIZE && height <= ATLAS_MAX_IMAGE_SIZE)
+	{
+		// Extrude the image edges into the padding
+		int padded_width = width + 2 * ATLAS_PADDING;
+		int padded_height = height + 2 * ATLAS_PADDING;
+		std::vector<stbi_uc> padded(padded_width * padded_height * 4);
+		for (int py = 0; py < padded_height; ++py)
+		{
+			int sy = std::min(std::max(py - ATLAS_PADDING, 0), height - 1);
+			for (int px = 0; px < padded_width; ++px)
+			{
+				int sx = std::min(std::max(px - ATLAS_PADDING, 0), width - 1);
+				std::copy_n(data + (sy * width + sx) * 4, 4, padded.data() + (py * padded_width + px) * 4);
+			}
+		}
+		stbi_image_free(data);
+
+		int x, y;
+		AtlasPage* page = atlas_allocate(padded_width, padded_height, x, y);
+		glBindTexture(GL_TEXTURE_2D, page->id);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, padded_width, padded_height, GL_RGBA, GL_UNSIGNED_BYTE, padded.data());
+
+		id = page->id;
+		in_atlas = true;
+		uv_offset = { (float)(x + ATLAS_PADDING) / ATLAS_PAGE_SIZE, (float)(y + ATLAS_PADDING) / ATLAS_PAGE_SIZE };
+		uv_scale = { (float)width / ATLAS_PAGE_SIZE, (float)height / ATLAS_PAGE_SIZE };
+
+		if (gl_has_errors())
+			return false;
+		s_atlas_regions[path] = { id, width, height, uv_offset, uv_scale };
+		return true;
+	}
+
 	glGenTextures(1, &id);
 	glBindTexture(GL_TEXTURE_2D, id);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
@@ -218,10 +339,71 @@ namespace
 
 		return true;
 	}
+
+	// Names of the Uniform and Attribute enums as they appear in the shaders
+	const char* uniform_names[] = { "transform", "projection", "headlight_channel", "screen_texture", "brick_map",
+									"camera_pos", "light_position", "light_angle", "torch_lightmap", "torch_lightmap_texel",
+									"sprite_size", "texture_rect", "distance_field", "distance_field_texel",
+									"shadow_map", "light_range", "light_terms" };
+	const char* attribute_names[] = { "in_position", "in_texcoord", "in_offset", "in_colour" };
+
+	static_assert(sizeof(uniform_names) / sizeof(uniform_names[0]) == (size_t)Uniform::count, "missing uniform name");
+	static_assert(sizeof(attribute_names) / sizeof(attribute_names[0]) == (size_t)Attribute::count, "missing attribute name");
+
+	// Linked program shared by every Effect loaded from the same shader pair and defines
+	struct ProgramEntry
+	{
+		GLuint vertex;
+		GLuint fragment;
+		GLuint program;
+		int ref_count;
+		GLint uniforms[(int)Uniform::count];
+		GLint attributes[(int)Attribute::count];
+	};
+
+	typedef std::tuple<std::string, std::string, std::string> ProgramKey;
+	std::map<ProgramKey, ProgramEntry> s_programs;
+
+	void gl_delete_program(GLuint vertex, GLuint fragment, GLuint program)
+	{
+		glDeleteProgram(program);
+		glDeleteShader(vertex);
+		glDeleteShader(fragment);
+	}
+
+	// GLSL only accepts #version as the first directive, so defines go right after it
+	std::string insert_defines(const std::string& source, const char* defines)
+	{
+		if (defines[0] == '\0')
+			return source;
+
+		size_t line_end = source.find('\n', source.find("#version"));
+		if (line_end == std::string::npos)
+			return source + "\n" + defines;
+		return source.substr(0, line_end + 1) + defines + source.substr(line_end + 1);
+	}
 }
 
-bool Effect::load_from_file(const char* vs_path, const char* fs_path) 
+bool Effect::load_from_file(const char* vs_path, const char* fs_path, const char* defines) 
 {
+	// Drop whatever this handle pointed at before
+	release();
+
+	// Only the first request for a shader pair and defines reads, compiles and links it
+	ProgramKey key(vs_path, fs_path, defines);
+	auto it = s_programs.find(key);
+	if (it != s_programs.end())
+	{
+		ProgramEntry& entry = it->second;
+		entry.ref_count++;
+		vertex = entry.vertex;
+		fragment = entry.fragment;
+		program = entry.program;
+		std::copy(entry.uniforms, entry.uniforms + (int)Uniform::count, uniforms);
+		std::copy(entry.attributes, entry.attributes + (int)Attribute::count, attributes);
+		return true;
+	}
+
 	gl_flush_errors();
 
 	// Opening files
@@ -238,8 +420,8 @@ bool Effect::load_from_file(const char* vs_path, const char* fs_path)
 	std::stringstream vs_ss, fs_ss;
 	vs_ss << vs_is.rdbuf();
 	fs_ss << fs_is.rdbuf();
-	std::string vs_str = vs_ss.str();
-	std::string fs_str = fs_ss.str();
+	std::string vs_str = insert_defines(vs_ss.str(), defines);
+	std::string fs_str = insert_defines(fs_ss.str(), defines);
 	const char* vs_src = vs_str.c_str();
 	const char* fs_src = fs_str.c_str();
 	GLsizei vs_len = (GLsizei)vs_str.size();
@@ -265,6 +447,8 @@ bool Effect::load_from_file(const char* vs_path, const char* fs_path)
 	program = glCreateProgram();
 	glAttachShader(program, vertex);
 	glAttachShader(program, fragment);
+	for (int i = 0; i < (int)Attribute::count; i++)
+		glBindAttribLocation(program, i, attribute_names[i]);
 	glLinkProgram(program);
 	{
 		GLint is_linked = 0;
@@ -276,7 +460,8 @@ bool Effect::load_from_file(const char* vs_path, const char* fs_path)
 			std::vector<char> log(log_len);
 			glGetProgramInfoLog(program, log_len, &log_len, log.data());
 
-			release();
+			gl_delete_program(vertex, fragment, program);
+			vertex = fragment = program = 0;
 			fprintf(stderr, "Link error: %s", log.data());
 			return false;
 		}
@@ -284,19 +469,53 @@ bool Effect::load_from_file(const char* vs_path, const char* fs_path)
 
 	if (gl_has_errors())
 	{
-		release();
+		gl_delete_program(vertex, fragment, program);
+		vertex = fragment = program = 0;
 		fprintf(stderr, "OpenGL errors occured while compiling Effect");
 		return false;
 	}
 
+	// Resolve every location once, draws only ever read the tables
+	ProgramEntry& entry = s_programs[key];
+	entry.vertex = vertex;
+	entry.fragment = fragment;
+	entry.program = program;
+	entry.ref_count = 1;
+	for (int i = 0; i < (int)Uniform::count; i++)
+		entry.uniforms[i] = uniforms[i] = glGetUniformLocation(program, uniform_names[i]);
+	for (int i = 0; i < (int)Attribute::count; i++)
+		entry.attributes[i] = attributes[i] = glGetAttribLocation(program, attribute_names[i]);
+
 	return true;
 }
 
 void Effect::release()
 {
-	glDeleteProgram(program);
-	glDeleteShader(vertex);
-	glDeleteShader(fragment);
+	if (program == 0)
+		return;
+
+	for (auto it = s_programs.begin(); it != s_programs.end(); ++it)
+	{
+		if (it->second.program != program)
+			continue;
+
+		// Last handle to this program, delete it for real
+		if (--it->second.ref_count <= 0)
+		{
+			gl_delete_program(it->second.vertex, it->second.fragment, it->second.program);
+			s_programs.erase(it);
+		}
+		break;
+	}
+
+	vertex = 0;
+	fragment = 0;
+	program = 0;
+}
+
+size_t Effect::live_programs()
+{
+	return s_programs.size();
 }
 
 void Transform::begin()
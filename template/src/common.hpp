@@ -22,15 +22,13 @@
 #define audio_path(name) data_path  "/audio/" name
 #define mesh_path(name) data_path  "/meshes/" name
 #define level_path data_path "/levels/json/"
-#define shadow_path data_path "/levels/shadow/"
 #define save_file data_path "/save/save_file.json"
 #define maker_file level_path "maker_level.json"
-#define maker_shadow shadow_path "maker_level_brickmap.bmp"
 
 enum class Status { nothing, title_menu, main_menu, new_game, load_game, resume, reset, save_game, exit,
 					story_mode, maker_mode, play_level, make_level, load_level,
 					go_to_intro_1, go_to_intro_2, go_to_intro_3, go_to_intro_4,  go_to_credits,
-					help, ret_pause, settings, inc_sens, dec_sens, maker_instructions };
+					help, ret_pause, settings, inc_sens, dec_sens, inc_light_res, dec_light_res, maker_instructions };
 
 // please add to this enum whenever you add background music
 enum class Music { standard, menu, level_builder, ghost_approach };
@@ -66,8 +64,11 @@ static const float brick_size = 64.f;
 static const float TOLERANCE = 0.005f;
 
 extern double scroll_sensitivity;
+// The lighting pass runs at the framebuffer size divided by this, 1, 2 or 4
+extern int lighting_downscale;
+// Light is rendered by the CPU backend instead of light.fs.glsl, for software GL where the shader is the bottleneck
+extern bool cpu_lighting;
 
-float get_closest_point(float last_pos, float tile_pos, float circle_width, float tile_width);
 bool within_range(float val, float low, float high);
 
 // OpenGL utilities
@@ -89,6 +90,23 @@ struct TexturedVertex
 	vec2 texcoord;
 };
 
+// Single Vertex Buffer element for batched sprites (textured.vs.glsl), already transformed to world space
+struct SpriteVertex
+{
+	vec2 position;
+	vec2 texcoord;
+	vec3 colour;
+	float alpha;
+};
+
+// Per instance element for instanced sprites (instanced.vs.glsl)
+struct SpriteInstance
+{
+	vec2 position;
+	vec3 colour;
+	float alpha;
+};
+
 // Texture wrapper
 struct Texture
 {
@@ -99,9 +117,16 @@ struct Texture
 	GLuint depth_render_buffer_id;
 	int width;
 	int height;
+
+	// Region of id the image occupies, the whole texture unless it was packed into an atlas page
+	vec2 uv_offset;
+	vec2 uv_scale;
+	bool in_atlas;
 	
 	// Loads texture from file specified by path
-	bool load_from_file(const char* path);
+	// Small images are packed into a shared atlas page so sprites using them can be drawn together,
+	// pass pack = false for textures sampled with their own coordinates (brick maps)
+	bool load_from_file(const char* path, bool pack = true);
 	bool is_valid()const; // True if texture is valid
 	bool create_from_screen(GLFWwindow const * const window); // Screen texture
 };
@@ -110,20 +135,43 @@ struct Texture
 // represents a Vertex Array Object and is the container for 1 or more Vertex Buffers and 
 // an Index Buffer.
 struct Mesh {
-	GLuint vao;
-	GLuint vbo;
-	GLuint ibo;
+	GLuint vao = 0;
+	GLuint vbo = 0;
+	GLuint ibo = 0;
 };
 
+// Every uniform any of our shaders reads. Locations are resolved once when a program is linked,
+// names a program does not use resolve to -1 which glUniform* silently ignores.
+enum class Uniform { transform, projection, headlight_channel, screen_texture, brick_map,
+					 camera_pos, light_position, light_angle, torch_lightmap, torch_lightmap_texel, sprite_size,
+					 texture_rect, distance_field, distance_field_texel, shadow_map, light_range, light_terms, count };
+
+// Every vertex attribute any of our shaders reads, bound to its index in this enum when a program is linked
+// so one vertex array layout works with every program
+enum class Attribute { in_position, in_texcoord, in_offset, in_colour, count };
+
 // Effect component of Entity for Vertex and Fragment shader, which are then put(linked) together in a
 // single program that is then bound to the pipeline.
+// An Effect is a handle into a shared, reference counted program registry keyed by the shader path pair
+// and defines, so every sprite using the same variant shares the one program compiled the first time it was requested.
 struct Effect {
-	GLuint vertex;
-	GLuint fragment;
-	GLuint program;
+	GLuint vertex = 0;
+	GLuint fragment = 0;
+	GLuint program = 0;
+
+	// Locations resolved at link time, indexed by Uniform / Attribute
+	GLint uniforms[(int)Uniform::count];
+	GLint attributes[(int)Attribute::count];
+
+	// load shaders from files and link into program, defines (one #define per line) are inserted
+	// after the #version line of both stages so one source can be compiled into several variants
+	bool load_from_file(const char* vs_path, const char* fs_path, const char* defines = "");
+	void release(); // release this handle, the program is deleted once no handle references it
+
+	GLint uniform(Uniform u) const { return uniforms[(int)u]; }
+	GLint attribute(Attribute a) const { return attributes[(int)a]; }
 
-	bool load_from_file(const char* vs_path, const char* fs_path); // load shaders from files and link into program
-	void release(); // release shaders and program
+	static size_t live_programs(); // number of GL programs currently held by the registry
 };
 
 // All data relevant to the motion of the salmon.
@@ -1,4 +1,5 @@
 #include "components.hpp"
+#include "gl_debug.hpp"
 
 int next_id = 0;
 
@@ -7,162 +8,119 @@ std::map<int, MotionComponent*> s_ui_motion_components;
 std::map<int, RenderComponent*> s_render_components;
 std::map<int, RenderComponent*> s_ui_render_components;
 
+namespace
+{
+	// Unit quad shared by every sprite, scaled to its texture size in the vertex shader
+	Mesh s_quad_mesh;
+	int s_quad_references = 0;
+
+	bool acquire_quad_mesh(Mesh& mesh)
+	{
+		if (s_quad_references++ > 0)
+		{
+			mesh = s_quad_mesh;
+			return true;
+		}
+
+		// The position corresponds to the center of the texture.
+		TexturedVertex vertices[4];
+		vertices[0].position = { -0.5f, +0.5f, -0.01f };
+		vertices[0].texcoord = { 0.f, 1.f };
+		vertices[1].position = { +0.5f, +0.5f, -0.01f };
+		vertices[1].texcoord = { 1.f, 1.f, };
+		vertices[2].position = { +0.5f, -0.5f, -0.01f };
+		vertices[2].texcoord = { 1.f, 0.f };
+		vertices[3].position = { -0.5f, -0.5f, -0.01f };
+		vertices[3].texcoord = { 0.f, 0.f };
+
+		// Counterclockwise as it's the default opengl front winding direction.
+		uint16_t indices[] = { 0, 3, 1, 1, 3, 2 };
+
+		// Clearing errors
+		gl_flush_errors();
+
+		// Vertex Array (Container for Vertex + Index buffer)
+		glGenVertexArrays(1, &s_quad_mesh.vao);
+		gl_bind_vertex_array(s_quad_mesh.vao);
+
+		// Vertex Buffer creation
+		glGenBuffers(1, &s_quad_mesh.vbo);
+		gl_bind_buffer(GL_ARRAY_BUFFER, s_quad_mesh.vbo);
+		gl_buffer_data(GL_ARRAY_BUFFER, sizeof(TexturedVertex) * 4, vertices, GL_STATIC_DRAW);
+
+		// Index Buffer creation
+		glGenBuffers(1, &s_quad_mesh.ibo);
+		gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, s_quad_mesh.ibo);
+		gl_buffer_data(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * 6, indices, GL_STATIC_DRAW);
+
+		// Attribute locations are fixed at link time, so the layout is recorded in the vao once
+		GLint in_position_loc = (GLint)Attribute::in_position;
+		GLint in_texcoord_loc = (GLint)Attribute::in_texcoord;
+		glEnableVertexAttribArray(in_position_loc);
+		glEnableVertexAttribArray(in_texcoord_loc);
+		glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)0);
+		glVertexAttribPointer(in_texcoord_loc, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)sizeof(vec3));
+		gl_bind_vertex_array(0);
+
+		mesh = s_quad_mesh;
+		return !gl_has_errors();
+	}
+
+	void release_quad_mesh(Mesh& mesh)
+	{
+		if (mesh.vao == 0)
+			return;
+
+		mesh = Mesh();
+		if (--s_quad_references > 0)
+			return;
+
+		glDeleteBuffers(1, &s_quad_mesh.vbo);
+		glDeleteBuffers(1, &s_quad_mesh.ibo);
+		glDeleteVertexArrays(1, &s_quad_mesh.vao);
+		s_quad_mesh = Mesh();
+	}
+}
+
+const char* sprite_variant_defines(SpriteVariant variant)
+{
+	switch (variant)
+	{
+	case SpriteVariant::hideable:
+		return "#define COLOUR_HIDEABLE\n";
+	default:
+		return "";
+	}
+}
+
 bool RenderComponent::init_sprite()
 {
-	// The position corresponds to the center of the texture.
-	float wr = texture->width * 0.5f;
-	float hr = texture->height * 0.5f;
-
-	TexturedVertex vertices[4];
-	vertices[0].position = { -wr, +hr, -0.01f };
-	vertices[0].texcoord = { 0.f, 1.f };
-	vertices[1].position = { +wr, +hr, -0.01f };
-	vertices[1].texcoord = { 1.f, 1.f, };
-	vertices[2].position = { +wr, -hr, -0.01f };
-	vertices[2].texcoord = { 1.f, 0.f };
-	vertices[3].position = { -wr, -hr, -0.01f };
-	vertices[3].texcoord = { 0.f, 0.f };
-
-	// Counterclockwise as it's the default opengl front winding direction.
-	uint16_t indices[] = { 0, 3, 1, 1, 3, 2 };
-
-	// Clearing errors
-	gl_flush_errors();
-
-	// Vertex Buffer creation
-	glGenBuffers(1, &mesh.vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(TexturedVertex) * 4, vertices, GL_STATIC_DRAW);
-
-	// Index Buffer creation
-	glGenBuffers(1, &mesh.ibo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * 6, indices, GL_STATIC_DRAW);
-
-	// Vertex Array (Container for Vertex + Index buffer)
-	glGenVertexArrays(1, &mesh.vao);
-	if (gl_has_errors())
+	size = { (float)texture->width, (float)texture->height };
+	alpha = 1.f;
+
+	// Invisible sprites only collide, they need neither the quad nor a program
+	if (is_invisible)
+	{
+		render = false;
+		return true;
+	}
+
+	if (mesh.vao == 0 && !acquire_quad_mesh(mesh))
 		return false;
 
 	// Loading shaders
-	if (!effect.load_from_file(shader_path("textured.vs.glsl"), shader_path("textured.fs.glsl")))
+	variant = can_be_hidden ? SpriteVariant::hideable : SpriteVariant::plain;
+	if (!effect.load_from_file(shader_path("textured.vs.glsl"), shader_path("sprite.fs.glsl"),
+							   sprite_variant_defines(variant)))
 		return false;
 
-	alpha = 1.f;
-
 	return true;
 }
 
-// Draw sprite with or without transparency
-// alpha is from 0.0 to 1.0 (from transparent to opaque)
-void RenderComponent::draw_ui_sprite_alpha(const mat3& projection, float alpha)
-{
-	// Setting shaders
-	glUseProgram(effect.program);
-
-	// Enabling alpha channel for textures
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glDisable(GL_DEPTH_TEST);
-
-	// Getting uniform locations for glUniform* calls
-	GLint transform_uloc = glGetUniformLocation(effect.program, "transform");
-	GLint color_uloc = glGetUniformLocation(effect.program, "fcolor");
-	GLint projection_uloc = glGetUniformLocation(effect.program, "projection");
-
-	// Setting vertices and indices
-	glBindVertexArray(mesh.vao);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
-
-	// Input data location as in the vertex buffer
-	GLint in_position_loc = glGetAttribLocation(effect.program, "in_position");
-	GLint in_texcoord_loc = glGetAttribLocation(effect.program, "in_texcoord");
-	glEnableVertexAttribArray(in_position_loc);
-	glEnableVertexAttribArray(in_texcoord_loc);
-	glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)0);
-	glVertexAttribPointer(in_texcoord_loc, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)sizeof(vec3));
-
-	// Enabling and binding texture to slot 0
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture->id);
-
-	// Setting uniform values to the currently bound program
-	glUniformMatrix3fv(transform_uloc, 1, GL_FALSE, (float*)&transform.out);
-	float color[] = { 1.f, 1.f, 1.f, alpha };
-	glUniform4fv(color_uloc, 1, color);
-	glUniformMatrix3fv(projection_uloc, 1, GL_FALSE, (float*)&projection);
-
-	// Drawing!
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, nullptr);
-}
-
-// Draw sprite with or without transparency
-// alpha is from 0.0 to 1.0 (from transparent to opaque)
-void RenderComponent::draw_sprite_alpha(const mat3& projection, float alpha, vec3 headlight_channel)
+void RenderComponent::release()
 {
-    // Setting shaders
-    glUseProgram(effect.program);
-
-    // Enabling alpha channel for textures
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glDisable(GL_DEPTH_TEST);
-
-    // Getting uniform locations for glUniform* calls
-    GLint transform_uloc = glGetUniformLocation(effect.program, "transform");
-    GLint color_uloc = glGetUniformLocation(effect.program, "fcolor");
-    GLint projection_uloc = glGetUniformLocation(effect.program, "projection");
-
-    // Setting vertices and indices
-    glBindVertexArray(mesh.vao);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
-
-    // Input data location as in the vertex buffer
-    GLint in_position_loc = glGetAttribLocation(effect.program, "in_position");
-    GLint in_texcoord_loc = glGetAttribLocation(effect.program, "in_texcoord");
-    glEnableVertexAttribArray(in_position_loc);
-    glEnableVertexAttribArray(in_texcoord_loc);
-    glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)0);
-    glVertexAttribPointer(in_texcoord_loc, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)sizeof(vec3));
-
-    // pass headlight channel
-    GLuint headlight_channel_uloc = glGetUniformLocation(effect.program, "headlight_channel");
-    float channel[] = {headlight_channel.x, headlight_channel.y, headlight_channel.z};
-    glUniform3fv(headlight_channel_uloc, 1, channel);
-
-    // pass component colour
-    GLuint component_colour_uloc = glGetUniformLocation(effect.program, "component_colour");
-    float component_colour[] = {colour.x, colour.y, colour.z};
-    glUniform3fv(component_colour_uloc, 1, component_colour);
-
-    // pass whether component can be hidden
-    GLuint should_render_uloc = glGetUniformLocation(effect.program, "component_can_be_hidden");
-    glUniform1i(should_render_uloc, can_be_hidden);
-
-    // pass whether component is invisible
-    GLuint is_invisible_uloc = glGetUniformLocation(effect.program, "component_is_invisible");
-    glUniform1i(is_invisible_uloc, is_invisible);
-
-    // Enabling and binding texture to slot 0
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture->id);
-
-    // Setting uniform values to the currently bound program
-    glUniformMatrix3fv(transform_uloc, 1, GL_FALSE, (float*)&transform.out);
-    float color[] = { colour.x, colour.y, colour.z, alpha };
-    glUniform4fv(color_uloc, 1, color);
-    glUniformMatrix3fv(projection_uloc, 1, GL_FALSE, (float*)&projection);
-    
-    // Drawing!
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, nullptr);
-
-
-    if (gl_has_errors())
-    {
-        gl_flush_errors();
-    }
+	release_quad_mesh(mesh);
+	effect.release();
 }
 
 void clear_level_components()
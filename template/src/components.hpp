@@ -17,22 +17,39 @@ struct MotionComponent
 extern std::map<int, MotionComponent*> s_motion_components;
 extern std::map<int, MotionComponent*> s_ui_motion_components;
 
+// Draw order of render components, later layers are drawn over earlier ones
+enum class Layer { background, scenery, bricks, actors };
+
+enum class Blend { alpha, additive };
+
+// Permutations of sprite.fs.glsl, chosen once when a sprite is initialised instead of branching per fragment.
+// Invisible sprites have no variant, they are never drawn.
+enum class SpriteVariant { plain, hideable, count };
+const char* sprite_variant_defines(SpriteVariant variant);
+
 struct RenderComponent
 {
 	Texture* texture;
 	Mesh mesh;
 	Effect effect;
 	Transform transform;
+	vec2 size; // quad size in pixels, the texture size when the sprite was initialised
 	bool render = true;
+	Layer layer = Layer::scenery;
+	bool is_static = false; // never moves once added to a rendering system, so culling buckets it once
+	Blend blend = Blend::alpha;
+	bool instanced = false; // drawn in a single instanced call, all instanced components share one texture and mesh
+	// Both have to be set before init_sprite, which picks the shader variant from them
 	int can_be_hidden = 0;
     int is_invisible = 0;
+	SpriteVariant variant = SpriteVariant::plain;
 	vec3 colour = {1.f, 1.f, 1.f};
 	float alpha;
 
+	// Takes a reference to the shared sprite quad and the textured program of its variant
 	bool init_sprite();
-	void draw_sprite_alpha(const mat3& projection, float alpha, vec3 headlight_channel);
-
-    void draw_ui_sprite_alpha(const mat3 &projection, float alpha);
+	// Drops the references taken by init_sprite
+	void release();
 };
 extern std::map<int, RenderComponent*> s_render_components;
 extern std::map<int, RenderComponent*> s_ui_render_components;
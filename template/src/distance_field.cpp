@@ -0,0 +1,127 @@
+#include "distance_field.hpp"
+#include "common.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+const float DistanceField::TEXEL_SIZE = brick_size / DistanceField::TEXELS_PER_BRICK;
+const float DistanceField::MAX_DISTANCE = 512.f;
+
+namespace
+{
+	const float INF = 1e20f;
+
+	// Squared distance transform of a sampled function in one dimension (Felzenszwalb & Huttenlocher),
+	// f holds 0 on features and INF elsewhere, d receives the squared distance to the closest feature
+	void distance_transform_1d(const float* f, int n, float* d, std::vector<int>& v, std::vector<float>& z)
+	{
+		v.resize(n);
+		z.resize(n + 1);
+
+		int k = 0;
+		v[0] = 0;
+		z[0] = -INF;
+		z[1] = INF;
+		for (int q = 1; q < n; q++)
+		{
+			// Intersection of the parabola rooted at q with the rightmost one of the lower envelope
+			float s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.f * q - 2.f * v[k]);
+			while (s <= z[k])
+			{
+				k--;
+				s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.f * q - 2.f * v[k]);
+			}
+			k++;
+			v[k] = q;
+			z[k] = s;
+			z[k + 1] = INF;
+		}
+
+		k = 0;
+		for (int q = 0; q < n; q++)
+		{
+			while (z[k + 1] < q)
+				k++;
+			d[q] = (q - v[k]) * (q - v[k]) + f[v[k]];
+		}
+	}
+
+	// Squared distance in texels from every texel to the closest one where feature is true
+	void distance_transform_2d(const std::vector<bool>& feature, int width, int height, std::vector<float>& out)
+	{
+		std::vector<float> f(std::max(width, height));
+		std::vector<float> d(std::max(width, height));
+		std::vector<int> v;
+		std::vector<float> z;
+
+		out.resize(width * height);
+		for (int i = 0; i < width * height; i++)
+			out[i] = feature[i] ? 0.f : INF;
+
+		// Columns then rows
+		for (int x = 0; x < width; x++)
+		{
+			for (int y = 0; y < height; y++)
+				f[y] = out[y * width + x];
+			distance_transform_1d(f.data(), height, d.data(), v, z);
+			for (int y = 0; y < height; y++)
+				out[y * width + x] = d[y];
+		}
+		for (int y = 0; y < height; y++)
+		{
+			distance_transform_1d(&out[y * width], width, d.data(), v, z);
+			std::copy(d.begin(), d.begin() + width, out.begin() + y * width);
+		}
+	}
+}
+
+void DistanceField::build(const std::vector<std::vector<bool>>& occupied, int width, int height)
+{
+	m_width = width * TEXELS_PER_BRICK;
+	m_height = height * TEXELS_PER_BRICK;
+
+	std::vector<bool> inside(m_width * m_height);
+	std::vector<bool> outside(m_width * m_height);
+	for (int y = 0; y < m_height; y++)
+	{
+		for (int x = 0; x < m_width; x++)
+		{
+			bool brick = occupied[y / TEXELS_PER_BRICK][x / TEXELS_PER_BRICK];
+			inside[y * m_width + x] = brick;
+			outside[y * m_width + x] = !brick;
+		}
+	}
+
+	// Distances between texel centres, moved half a texel so the field crosses zero on the brick edges
+	std::vector<float> to_inside, to_outside;
+	distance_transform_2d(inside, m_width, m_height, to_inside);
+	distance_transform_2d(outside, m_width, m_height, to_outside);
+
+	m_distances.resize(m_width * m_height);
+	for (int i = 0; i < m_width * m_height; i++)
+	{
+		float distance;
+		if (inside[i])
+			distance = -(std::sqrt(to_outside[i]) - 0.5f) * TEXEL_SIZE;
+		else
+			distance = (std::sqrt(to_inside[i]) - 0.5f) * TEXEL_SIZE;
+		m_distances[i] = std::max(-MAX_DISTANCE, std::min(distance, MAX_DISTANCE));
+	}
+}
+
+float DistanceField::sample(float x, float y) const
+{
+	// Texel centres sit half a texel in, positions past the edges clamp to them
+	float u = std::max(0.f, std::min(x / TEXEL_SIZE - 0.5f, m_width - 1.f));
+	float v = std::max(0.f, std::min(y / TEXEL_SIZE - 0.5f, m_height - 1.f));
+	int x0 = (int)u;
+	int y0 = (int)v;
+	int x1 = std::min(x0 + 1, m_width - 1);
+	int y1 = std::min(y0 + 1, m_height - 1);
+	float fx = u - x0;
+	float fy = v - y0;
+
+	float top = m_distances[y0 * m_width + x0] * (1 - fx) + m_distances[y0 * m_width + x1] * fx;
+	float bottom = m_distances[y1 * m_width + x0] * (1 - fx) + m_distances[y1 * m_width + x1] * fx;
+	return top * (1 - fy) + bottom * fy;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+
+// Signed distance in pixels to the nearest light occluder, sampled on a grid of TEXEL_SIZE pixel texels
+// covering the level from the top left corner of its first brick. Negative inside occluders.
+class DistanceField
+{
+public:
+	static const int TEXELS_PER_BRICK = 8;
+	static const float TEXEL_SIZE;
+	// Distances are clamped to this, rays never need to look further ahead
+	static const float MAX_DISTANCE;
+
+	// occupied[y][x] is true for bricks that block light
+	void build(const std::vector<std::vector<bool>>& occupied, int width, int height);
+
+	int get_width() const { return m_width; }
+	int get_height() const { return m_height; }
+	const float* data() const { return m_distances.data(); }
+
+	// Bilinear lookup at a pixel position relative to the level, as the texture uploaded by Light is filtered
+	float sample(float x, float y) const;
+
+private:
+	int m_width = 0;
+	int m_height = 0;
+	std::vector<float> m_distances; // row major, m_width x m_height
+};
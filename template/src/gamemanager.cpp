@@ -1,5 +1,7 @@
 #include "gamemanager.hpp"
+#include "gl_debug.hpp"
 
+#include <cstdlib>
 #include <sstream>
 #include <vector>
 #include <utility>
@@ -62,6 +64,19 @@ bool GameManager::init(vec2 screen)
 	// Load OpenGL function pointers
 	gl3w_init();
 
+	// GL error reporting through KHR_debug instead of glGetError polling, either built in or set EITD_GL_DEBUG
+#ifndef EITD_GL_DEBUG_OUTPUT
+	if (getenv("EITD_GL_DEBUG") != nullptr)
+#endif
+		gl_enable_debug_output();
+
+	// Per frame GL counters written to the file named by EITD_GL_STATS
+	if (getenv("EITD_GL_STATS") != nullptr)
+		gl_open_stats_dump(getenv("EITD_GL_STATS"));
+
+	// Lighting rendered on the CPU when EITD_CPU_LIGHTING is set
+	cpu_lighting = getenv("EITD_CPU_LIGHTING") != nullptr;
+
 	// Setting callbacks to member functions (that's why the redirect is needed)
 	// Input is handled using GLFW, for more info see
 	// http://www.glfw.org/docs/latest/input_guide.html
@@ -170,6 +185,8 @@ void GameManager::draw()
 	{
 		m_world.draw();
 	}
+
+	gl_end_frame();
 }
 
 bool GameManager::game_over()
@@ -195,6 +212,8 @@ bool GameManager::game_over()
 
 void GameManager::destroy()
 {
+	gl_close_stats_dump();
+
 	m_title_menu.destroy();
 	m_main_menu.destroy();
 	m_world_pause_menu.destroy();
@@ -435,6 +454,18 @@ void GameManager::on_click(GLFWwindow* window, int button, int action, int mods)
 				scroll_sensitivity /= 2.f;
 			}
 			break;
+		case Status::inc_light_res:
+			if (lighting_downscale > 1)
+			{
+				lighting_downscale /= 2;
+			}
+			break;
+		case Status::dec_light_res:
+			if (lighting_downscale < 4)
+			{
+				lighting_downscale *= 2;
+			}
+			break;
 		case Status::maker_instructions:
 			m_menu = &m_maker_instructions_menu;
 		default:
@@ -608,10 +639,13 @@ void GameManager::load_loading_menu()
 
 void GameManager::load_settings_menu()
 {
-	vec2 button_size = { 8.f * brick_size, 2.f * brick_size };
+	// Smaller than the other menus' buttons so all five fit on screen
+	vec2 button_size = { 6.f * brick_size, 1.5f * brick_size };
 	std::vector<std::tuple<std::string, Status, vec2>> buttons;
 	buttons.push_back(std::make_tuple("inc_sens.png", Status::inc_sens, button_size));
 	buttons.push_back(std::make_tuple("dec_sens.png", Status::dec_sens, button_size));
+	buttons.push_back(std::make_tuple("inc_light_res.png", Status::inc_light_res, button_size));
+	buttons.push_back(std::make_tuple("dec_light_res.png", Status::dec_light_res, button_size));
 	buttons.push_back(std::make_tuple("main_menu.png", Status::main_menu, button_size));
 	m_settings_menu.setup(buttons);
 }
@@ -117,7 +117,7 @@ vec3 Ghost::get_colour()
 	return m_colour;
 }
 
-Hitbox Ghost::get_hitbox() const
+const Hitbox& Ghost::get_hitbox() const
 {
     return m_hitbox;
 }
@@ -157,15 +157,12 @@ float Ghost::dist_from_goal() {
 }
 
 void Ghost::calculate_hitbox() {
-    std::vector<Square> squares(1);
-
     float width = brick_size;
     vec2 position = mc.position;
     position.x -= width / 2;
     position.y += width / 2;
     Square square(position, (int)width);
-    squares[0] = square;
 
-    Hitbox hitbox({}, squares);
+    Hitbox hitbox({}, {square});
     m_hitbox = hitbox;
 }
@@ -32,7 +32,7 @@ public:
 	vec3 get_colour();
 
 	// Returns the bricks hitbox for collision detection
-	Hitbox get_hitbox() const;
+	const Hitbox& get_hitbox() const;
 
 	// Tell the ghost where it wants to go
 	void set_goal(vec2 position);
@@ -0,0 +1,100 @@
+#include "gl_debug.hpp"
+
+#include <cstdio>
+
+namespace gl_counters
+{
+	int current[(int)GLCounter::count] = {};
+}
+
+namespace
+{
+	int s_last_frame[(int)GLCounter::count] = {};
+	unsigned long s_frame = 0;
+	FILE* s_dump = nullptr;
+	bool s_debug_output = false;
+
+	const char* counter_names[] = { "draw_calls", "binds", "uniform_uploads", "buffer_uploads", "state_changes" };
+	static_assert(sizeof(counter_names) / sizeof(counter_names[0]) == (size_t)GLCounter::count, "missing counter name");
+
+	void APIENTRY gl_debug_callback(GLenum /*source*/, GLenum type, GLuint /*id*/, GLenum /*severity*/,
+									GLsizei /*length*/, const GLchar* message, const void* /*user_param*/)
+	{
+		fprintf(stderr, "GL%s: %s\n", type == GL_DEBUG_TYPE_ERROR ? " error" : "", message);
+	}
+}
+
+void gl_end_frame()
+{
+	for (int i = 0; i < (int)GLCounter::count; ++i)
+	{
+		s_last_frame[i] = gl_counters::current[i];
+		gl_counters::current[i] = 0;
+	}
+
+	if (s_dump != nullptr)
+	{
+		fprintf(s_dump, "%lu", s_frame);
+		for (int i = 0; i < (int)GLCounter::count; ++i)
+			fprintf(s_dump, ",%d", s_last_frame[i]);
+		fprintf(s_dump, "\n");
+	}
+
+	s_frame++;
+}
+
+int gl_frame_count(GLCounter counter)
+{
+	return s_last_frame[(int)counter];
+}
+
+bool gl_enable_debug_output()
+{
+	// Core in 4.3, otherwise only present through KHR_debug
+	if (glDebugMessageCallback == nullptr || glDebugMessageControl == nullptr)
+	{
+		fprintf(stderr, "GL debug output unavailable, polling glGetError\n");
+		return false;
+	}
+
+	glEnable(GL_DEBUG_OUTPUT);
+	glDebugMessageCallback(gl_debug_callback, nullptr);
+	// Notifications (buffer placement hints and the like) are too chatty to be useful
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+
+	s_debug_output = true;
+	return true;
+}
+
+bool gl_debug_output_enabled()
+{
+	return s_debug_output;
+}
+
+bool gl_open_stats_dump(const char* path)
+{
+	gl_close_stats_dump();
+
+	s_dump = fopen(path, "w");
+	if (s_dump == nullptr)
+	{
+		fprintf(stderr, "Failed to open GL stats dump %s\n", path);
+		return false;
+	}
+
+	fprintf(s_dump, "frame");
+	for (const char* name : counter_names)
+		fprintf(s_dump, ",%s", name);
+	fprintf(s_dump, "\n");
+
+	return true;
+}
+
+void gl_close_stats_dump()
+{
+	if (s_dump != nullptr)
+	{
+		fclose(s_dump);
+		s_dump = nullptr;
+	}
+}
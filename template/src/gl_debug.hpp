@@ -0,0 +1,145 @@
+#pragma once
+
+#include "common.hpp"
+
+// Counting layer over the GL calls the renderer issues every frame, plus optional KHR_debug error reporting.
+// Call the gl_* wrappers below instead of the raw GL entry points on any per frame path.
+
+enum class GLCounter { draw_calls, binds, uniform_uploads, buffer_uploads, state_changes, count };
+
+// Closes the current frame: its counters become the ones gl_frame_count reports
+// and are appended to the dump file if one is open
+void gl_end_frame();
+int gl_frame_count(GLCounter counter);
+
+// Reports GL errors through a KHR_debug callback, gl_has_errors() then stops polling glGetError.
+// Returns false when the context exposes no debug output, errors keep being polled in that case.
+bool gl_enable_debug_output();
+bool gl_debug_output_enabled();
+
+// Appends one line of counters per frame to path until closed
+bool gl_open_stats_dump(const char* path);
+void gl_close_stats_dump();
+
+namespace gl_counters
+{
+	extern int current[(int)GLCounter::count];
+}
+
+inline void gl_count(GLCounter counter, int n = 1)
+{
+	gl_counters::current[(int)counter] += n;
+}
+
+// Draws
+inline void gl_draw_elements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+{
+	gl_count(GLCounter::draw_calls);
+	glDrawElements(mode, count, type, indices);
+}
+
+inline void gl_draw_elements_instanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances)
+{
+	gl_count(GLCounter::draw_calls);
+	glDrawElementsInstanced(mode, count, type, indices, instances);
+}
+
+inline void gl_draw_arrays(GLenum mode, GLint first, GLsizei count)
+{
+	gl_count(GLCounter::draw_calls);
+	glDrawArrays(mode, first, count);
+}
+
+// Binds
+inline void gl_use_program(GLuint program)
+{
+	gl_count(GLCounter::binds);
+	glUseProgram(program);
+}
+
+inline void gl_bind_texture(GLenum target, GLuint texture)
+{
+	gl_count(GLCounter::binds);
+	glBindTexture(target, texture);
+}
+
+inline void gl_bind_vertex_array(GLuint vao)
+{
+	gl_count(GLCounter::binds);
+	glBindVertexArray(vao);
+}
+
+inline void gl_bind_buffer(GLenum target, GLuint buffer)
+{
+	gl_count(GLCounter::binds);
+	glBindBuffer(target, buffer);
+}
+
+inline void gl_bind_framebuffer(GLenum target, GLuint framebuffer)
+{
+	gl_count(GLCounter::binds);
+	glBindFramebuffer(target, framebuffer);
+}
+
+// Uniform uploads
+inline void gl_uniform_1i(GLint location, GLint v)
+{
+	gl_count(GLCounter::uniform_uploads);
+	glUniform1i(location, v);
+}
+
+inline void gl_uniform_1f(GLint location, GLfloat v)
+{
+	gl_count(GLCounter::uniform_uploads);
+	glUniform1f(location, v);
+}
+
+inline void gl_uniform_2fv(GLint location, GLsizei count, const GLfloat* v)
+{
+	gl_count(GLCounter::uniform_uploads);
+	glUniform2fv(location, count, v);
+}
+
+inline void gl_uniform_3fv(GLint location, GLsizei count, const GLfloat* v)
+{
+	gl_count(GLCounter::uniform_uploads);
+	glUniform3fv(location, count, v);
+}
+
+inline void gl_uniform_4fv(GLint location, GLsizei count, const GLfloat* v)
+{
+	gl_count(GLCounter::uniform_uploads);
+	glUniform4fv(location, count, v);
+}
+
+inline void gl_uniform_matrix_3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* v)
+{
+	gl_count(GLCounter::uniform_uploads);
+	glUniformMatrix3fv(location, count, transpose, v);
+}
+
+// Buffer uploads
+inline void gl_buffer_data(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+	gl_count(GLCounter::buffer_uploads);
+	glBufferData(target, size, data, usage);
+}
+
+// Fixed function state
+inline void gl_enable(GLenum cap)
+{
+	gl_count(GLCounter::state_changes);
+	glEnable(cap);
+}
+
+inline void gl_disable(GLenum cap)
+{
+	gl_count(GLCounter::state_changes);
+	glDisable(cap);
+}
+
+inline void gl_blend_func(GLenum sfactor, GLenum dfactor)
+{
+	gl_count(GLCounter::state_changes);
+	glBlendFunc(sfactor, dfactor);
+}
@@ -1,10 +1,17 @@
 #include "hitbox.hpp"
 #include <math.h>
+#include <cassert>
 
-Hitbox::Hitbox(std::vector<Circle> circles, std::vector<Square> squares)
+Hitbox::Hitbox(std::initializer_list<Circle> circles, std::initializer_list<Square> squares)
 {
-	this->circles = circles;
-	this->squares = squares;
+	assert(circles.size() <= MAX_CIRCLES && squares.size() <= MAX_SQUARES);
+	for (const Circle& c : circles)
+		if (this->circle_count < MAX_CIRCLES)
+			this->circles[this->circle_count++] = c;
+
+	for (const Square& s : squares)
+		if (this->square_count < MAX_SQUARES)
+			this->squares[this->square_count++] = s;
 }
 
 Hitbox::Hitbox()
@@ -12,14 +19,14 @@ Hitbox::Hitbox()
 
 }
 
-bool Hitbox::collides_with(Hitbox hb)
+bool Hitbox::collides_with(const Hitbox &hb) const
 {
-	for (Circle c : this->circles)
-		if (hb.collides_with(c))
+	for (int i = 0; i < this->circle_count; i++)
+		if (hb.collides_with(this->circles[i]))
 			return true;
 
-	for (Square s : this->squares)
-		if (hb.collides_with(s))
+	for (int i = 0; i < this->square_count; i++)
+		if (hb.collides_with(this->squares[i]))
 			return true;
 
 	return false;
@@ -27,38 +34,89 @@ bool Hitbox::collides_with(Hitbox hb)
 
 void Hitbox::translate(vec2 translation)
 {
-	for (Circle& c : this->circles)
+	for (int i = 0; i < this->circle_count; i++)
 	{
-		c.translate(translation);
+		this->circles[i].translate(translation);
 	}
 
-	for (Square& s : this->squares)
+	for (int i = 0; i < this->square_count; i++)
 	{
-		s.translate(translation);
+		this->squares[i].translate(translation);
 	}
 }
 
-bool Hitbox::collides_with(Circle &circle)
+void Hitbox::get_bounds(vec2& min, vec2& max) const
 {
-	for (Circle c : this->circles)
-		if (circle.collides_with(c))
+	if (this->circle_count == 0 && this->square_count == 0)
+	{
+		min = max = { 0.f, 0.f };
+		return;
+	}
+
+	min = { INFINITY, INFINITY };
+	max = { -INFINITY, -INFINITY };
+	for (int i = 0; i < this->circle_count; i++)
+		this->circles[i].add_to_bounds(min, max);
+
+	for (int i = 0; i < this->square_count; i++)
+		this->squares[i].add_to_bounds(min, max);
+}
+
+void Hitbox::touching(const ShapeBatch& batch, uint32_t& circles, uint32_t& boxes) const
+{
+	for (int i = 0; i < this->circle_count; i++)
+		this->circles[i].touching(batch, circles, boxes);
+
+	for (int i = 0; i < this->square_count; i++)
+		this->squares[i].touching(batch, circles, boxes);
+}
+
+bool Hitbox::add_to_batch(ShapeBatch& batch) const
+{
+	if (batch.get_circle_count() + this->circle_count > ShapeBatch::CAPACITY ||
+		batch.get_box_count() + this->square_count > ShapeBatch::CAPACITY)
+		return false;
+
+	for (int i = 0; i < this->circle_count; i++)
+		this->circles[i].add_to_batch(batch);
+
+	for (int i = 0; i < this->square_count; i++)
+		this->squares[i].add_to_batch(batch);
+
+	return true;
+}
+
+int Hitbox::get_circle_count() const
+{
+	return this->circle_count;
+}
+
+int Hitbox::get_square_count() const
+{
+	return this->square_count;
+}
+
+bool Hitbox::collides_with(const Circle &circle) const
+{
+	for (int i = 0; i < this->circle_count; i++)
+		if (circle.collides_with(this->circles[i]))
 			return true;
 
-	for (Square s : this->squares)
-		if (circle.collides_with(s))
+	for (int i = 0; i < this->square_count; i++)
+		if (circle.collides_with(this->squares[i]))
 			return true;
 
 	return false;
 }
 
-bool Hitbox::collides_with(Square& square)
+bool Hitbox::collides_with(const Square& square) const
 {
-	for (Circle c : this->circles)
-		if (square.collides_with(c))
+	for (int i = 0; i < this->circle_count; i++)
+		if (square.collides_with(this->circles[i]))
 			return true;
 
-	for (Square s : this->squares)
-		if (square.collides_with(s))
+	for (int i = 0; i < this->square_count; i++)
+		if (square.collides_with(this->squares[i]))
 			return true;
 
 	return false;
@@ -75,12 +133,14 @@ Circle::Circle()
 
 }
 
-bool Circle::collides_with(Circle &circle)
+bool Circle::collides_with(const Circle &circle) const
 {
-	return len(sub(circle.centre, this->centre)) <= circle.radius + this->radius + TOLERANCE;
+	vec2 d = sub(circle.centre, this->centre);
+	float distance = circle.radius + this->radius + TOLERANCE;
+	return dot(d, d) <= distance * distance;
 }
 
-bool Circle::collides_with(Square &square)
+bool Circle::collides_with(const Square &square) const
 {
 	float testX = this->centre.x;
 	float testY = this->centre.y;
@@ -100,9 +160,20 @@ bool Circle::collides_with(Square &square)
 
 	float distX = this->centre.x - testX;
 	float distY = this->centre.y - testY;
-	float distance = sqrt((distX * distX) + (distY * distY));
+	float distance = this->radius + TOLERANCE;
+
+	return (distX * distX) + (distY * distY) <= distance * distance;
+}
+
+void Circle::touching(const ShapeBatch& batch, uint32_t& circles, uint32_t& boxes) const
+{
+	circles |= batch.circles_touching_circle(this->centre, (float)this->radius, TOLERANCE);
+	boxes |= batch.boxes_touching_circle(this->centre, (float)this->radius, TOLERANCE);
+}
 
-	return distance <= this->radius + TOLERANCE;
+bool Circle::add_to_batch(ShapeBatch& batch) const
+{
+	return batch.add_circle(this->centre, (float)this->radius);
 }
 
 void Circle::translate(vec2 translation)
@@ -111,6 +182,12 @@ void Circle::translate(vec2 translation)
 	this->centre = new_centre;
 }
 
+void Circle::add_to_bounds(vec2& min, vec2& max) const
+{
+	min = { fminf(min.x, this->centre.x - this->radius), fminf(min.y, this->centre.y - this->radius) };
+	max = { fmaxf(max.x, this->centre.x + this->radius), fmaxf(max.y, this->centre.y + this->radius) };
+}
+
 Square::Square(vec2 bottomLeft, int width)
 {
 	this->bottomLeft = bottomLeft;
@@ -122,12 +199,12 @@ Square::Square()
 	
 }
 
-bool Square::collides_with(Circle &circle)
+bool Square::collides_with(const Circle &circle) const
 {
 	return circle.collides_with(*this);
 }
 
-bool Square::collides_with(Square &square)
+bool Square::collides_with(const Square &square) const
 {
 	bool xOverlap = this->get_left() <= square.get_right() + TOLERANCE
 		&& this->get_right() + TOLERANCE >= square.get_left();
@@ -137,27 +214,46 @@ bool Square::collides_with(Square &square)
 	return xOverlap && yOverlap;
 }
 
+void Square::touching(const ShapeBatch& batch, uint32_t& circles, uint32_t& boxes) const
+{
+	vec2 min = { this->get_left(), this->get_top() };
+	vec2 max = { this->get_right(), this->get_bottom() };
+	circles |= batch.circles_touching_box(min, max, TOLERANCE);
+	boxes |= batch.boxes_touching_box(min, max, TOLERANCE);
+}
+
+bool Square::add_to_batch(ShapeBatch& batch) const
+{
+	return batch.add_box({ this->get_left(), this->get_top() }, { this->get_right(), this->get_bottom() });
+}
+
 void Square::translate(vec2 translation)
 {
 	this->bottomLeft = add(this->bottomLeft, translation);
 }
 
-float Square::get_left()
+void Square::add_to_bounds(vec2& min, vec2& max) const
+{
+	min = { fminf(min.x, this->get_left()), fminf(min.y, this->get_top()) };
+	max = { fmaxf(max.x, this->get_right()), fmaxf(max.y, this->get_bottom()) };
+}
+
+float Square::get_left() const
 {
 	return this->bottomLeft.x;
 }
 
-float Square::get_right()
+float Square::get_right() const
 {
 	return this->bottomLeft.x + this->width;
 }
 
-float Square::get_top()
+float Square::get_top() const
 {
 	return this->bottomLeft.y - this->width;
 }
 
-float Square::get_bottom()
+float Square::get_bottom() const
 {
 	return this->bottomLeft.y;
 }
\ No newline at end of file
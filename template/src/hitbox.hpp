@@ -1,7 +1,8 @@
 #pragma once
 
 #include "common.hpp"
-#include <vector>
+#include "shape_batch.hpp"
+#include <initializer_list>
 
 class Circle;
 class Square;
@@ -16,14 +17,23 @@ public:
 	Circle();
 
 	// Return true if this collides with the given circle
-	bool collides_with(Circle &circle);
+	bool collides_with(const Circle &circle) const;
 
 	// Return true if this collides with the given square
-	bool collides_with(Square &square);
+	bool collides_with(const Square &square) const;
 
 	// Translates the circle
 	void translate(vec2 translation);
 
+	// Grows the box min, max over the circle
+	void add_to_bounds(vec2& min, vec2& max) const;
+
+	// Sets the bits of the batch's circles and boxes this collides with
+	void touching(const ShapeBatch& batch, uint32_t& circles, uint32_t& boxes) const;
+
+	// Adds the circle to the batch, false when it is full
+	bool add_to_batch(ShapeBatch& batch) const;
+
 private:
 	// Position of the centre of the circle
 	vec2 centre;
@@ -42,25 +52,34 @@ public:
 	Square();
 
 	// Return true if this collides with the given circle
-	bool collides_with(Circle &circle);
+	bool collides_with(const Circle &circle) const;
 
 	// Return true if this collides with the given square
-	bool collides_with(Square &square);
+	bool collides_with(const Square &square) const;
 
 	// Translates the square
 	void translate(vec2 translation);
 
+	// Grows the box min, max over the square
+	void add_to_bounds(vec2& min, vec2& max) const;
+
+	// Sets the bits of the batch's circles and boxes this collides with
+	void touching(const ShapeBatch& batch, uint32_t& circles, uint32_t& boxes) const;
+
+	// Adds the square to the batch, false when it is full
+	bool add_to_batch(ShapeBatch& batch) const;
+
 	// Get the left most x coordinate of the square
-	float get_left();
+	float get_left() const;
 
 	// Get the right most x coordinate of the square
-	float get_right();
+	float get_right() const;
 
 	// Get the top most y coordinate of the square
-	float get_top();
+	float get_top() const;
 
 	// Get the bottom most y coordinate of the square
-	float get_bottom();
+	float get_bottom() const;
 
 private:
 	// Position of the bottom left vertex of the square
@@ -70,31 +89,52 @@ private:
 	int width;
 };
 
-// Collection of circles and squares with collision detection
+// Collection of circles and squares with collision detection. The shapes are stored inline, so hitboxes
+// are copied and translated every tick without allocating.
 class Hitbox
 {
 public:
+	// Most shapes of each kind a hitbox holds, doors and signs use two squares
+	static const int MAX_CIRCLES = 2;
+	static const int MAX_SQUARES = 2;
+
 	// Constructor
-	Hitbox(std::vector<Circle> circles, std::vector<Square> squares);
+	Hitbox(std::initializer_list<Circle> circles, std::initializer_list<Square> squares);
 
 	Hitbox();
 	
 	// Returns true if this collides with the given hitbox
-	bool collides_with(Hitbox obj);
+	bool collides_with(const Hitbox &obj) const;
 
 	// Translates the entire hitbox
 	void translate(vec2 translation);
 
+	// Smallest box holding every shape, for the broadphase
+	void get_bounds(vec2& min, vec2& max) const;
+
+	// Sets the bits of the batch's circles and boxes this collides with, collides_with against many hitboxes
+	// at once
+	void touching(const ShapeBatch& batch, uint32_t& circles, uint32_t& boxes) const;
+
+	// Adds every shape to the batch, false when it has no room for them all
+	bool add_to_batch(ShapeBatch& batch) const;
+
+	// Shapes of each kind in the hitbox
+	int get_circle_count() const;
+	int get_square_count() const;
+
 private:
 	// Returns true if this collides with the given circle
-	bool collides_with(Circle& circle);
+	bool collides_with(const Circle& circle) const;
 
 	// Returns true if this collides with the given square
-	bool collides_with(Square& square);
+	bool collides_with(const Square& square) const;
 
 	// Collection of circles in the hitbox
-	std::vector<Circle> circles;
+	Circle circles[MAX_CIRCLES];
+	int circle_count = 0;
 
 	// Collection of squares in the hitbox
-	std::vector<Square> squares;
+	Square squares[MAX_SQUARES];
+	int square_count = 0;
 };
\ No newline at end of file
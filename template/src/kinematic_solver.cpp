@@ -0,0 +1,57 @@
+#include "kinematic_solver.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+KinematicSolver::Handle KinematicSolver::add(const KinematicBody& body)
+{
+	// TileGrid only looks for bricks around the cell of the centre
+	assert(body.radius < brick_size);
+	m_bodies.push_back(body);
+	return (Handle)m_bodies.size() - 1;
+}
+
+KinematicBody& KinematicSolver::get(Handle handle)
+{
+	return m_bodies[handle];
+}
+
+int KinematicSolver::size() const
+{
+	return (int)m_bodies.size();
+}
+
+void KinematicSolver::clear()
+{
+	m_bodies.clear();
+}
+
+void KinematicSolver::solve(const TileGrid& tiles, vec3 headlight_channel)
+{
+	for (KinematicBody& body : m_bodies)
+	{
+		TileGrid::SlideResult result = tiles.move_circle(body.position, body.radius, body.motion, headlight_channel);
+		body.position = result.position;
+		body.contact_count = result.contact_count;
+		body.impact_speed = 0.f;
+
+		bool grounded = false;
+		for (int i = 0; i < result.contact_count; i++)
+		{
+			vec2 normal = result.contacts[i].normal;
+			float into = dot(body.velocity, normal);
+			if (into < 0.f)
+			{
+				body.impact_speed = std::max(body.impact_speed, -into);
+				body.velocity = sub(body.velocity, mul(normal, (1.f + body.restitution) * into));
+			}
+
+			// Normals point out of the brick, up is negative y
+			if (normal.y < -0.5f)
+				grounded = true;
+		}
+
+		if (grounded && body.on_grounded != nullptr)
+			body.on_grounded(body.owner);
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "common.hpp"
+#include "tile_grid.hpp"
+
+#include <vector>
+
+// A circle moved through the level's bricks by KinematicSolver. Its owner sets the motion it wants each tick,
+// the solver moves it as far as the bricks allow and takes away the velocity it had into them.
+struct KinematicBody
+{
+	float radius = 0.f; // under a brick
+	vec2 position = { 0.f, 0.f };
+	vec2 motion = { 0.f, 0.f }; // wanted this tick
+	vec2 velocity = { 0.f, 0.f }; // in the owner's units, only its direction against contacts matters
+	float restitution = 0.f; // share of the velocity into a brick bounced back
+
+	// Called when the body lands on a brick below it
+	void (*on_grounded)(void* owner) = nullptr;
+	void* owner = nullptr;
+
+	// Set by the solver, speed into the hardest hit brick of the last solve and how many it slid along
+	float impact_speed = 0.f;
+	int contact_count = 0;
+};
+
+// Moves every body of the level through the tile grid in one pass over contiguous storage, so more bodies cost
+// no more code and only their own sweeps
+class KinematicSolver
+{
+public:
+	typedef int Handle;
+
+	// Handles stay valid until clear
+	Handle add(const KinematicBody& body);
+	KinematicBody& get(Handle handle);
+	int size() const;
+
+	// Drops every body
+	void clear();
+
+	// Moves each body by its motion through the bricks solid under headlight_channel
+	void solve(const TileGrid& tiles, vec3 headlight_channel);
+
+private:
+	std::vector<KinematicBody> m_bodies;
+};
@@ -1,6 +1,9 @@
 #include <iostream>
+#include <iterator>
 #include "level.hpp"
 #include "torch.hpp"
+#include "gl_debug.hpp"
+#include <chrono>
 
 using json = nlohmann::json;
 
@@ -8,13 +11,31 @@ namespace
 {
     const size_t GHOST_DANGER_DIST = 500;
     const size_t COLLISION_SOUND_MIN_VEL = 5;
+
+    // Radii of the robot body and head hitboxes
+    const float ROBOT_RADIUS = brick_size / 2.f;
+    const float ROBOT_HEAD_RADIUS = 21.f;
+
+    // Bodies added with F5 to load the kinematic solver, bouncing around the level like small props
+    const int STRESS_BODY_COUNT = 1000;
+    const float STRESS_BODY_RADIUS = 12.f;
+    const float STRESS_BODY_SPEED = 45.f;
+    const float STRESS_GRAVITY = 75.f;
+    const int STRESS_REPORT_TICKS = 60;
+
+    // Mask of the batch shapes first to end
+    uint32_t bits_between(int first, int end)
+    {
+        uint32_t below_end = end >= 32 ? 0xffffffffu : (1u << end) - 1u;
+        return below_end & ~((1u << first) - 1u);
+    }
 }
 
 void Level::destroy()
 {
 	// clear all level-dependent resources
-	for (auto& brick_element : m_brick_map) {
-		delete brick_element.second;
+	for (auto& brick : m_tiles.get_bricks()) {
+		delete brick;
 	}
 	for (auto& interactable : m_interactables) {
 		delete interactable;
@@ -35,10 +56,15 @@ void Level::destroy()
 	clear_level_components();
 	m_rendering_system.clear();
 	m_interactable = NULL;
-    m_brick_map.clear();
+    m_tiles.init(0, 0);
+    m_bodies.clear();
+    m_stress_bodies.clear();
     m_ghosts.clear();
     m_interactables.clear();
     m_signs.clear();
+    m_broadphase.clear();
+    m_ghost_handles.clear();
+    m_shown_signs.clear();
     m_torches.clear();
 	m_backgrounds.clear();
     m_rendering_system.destroy();
@@ -46,13 +72,24 @@ void Level::destroy()
 	m_robot.destroy();
 }
 
-void Level::draw_entities(const mat3 &projection, const vec2 &camera_shift) {
+void Level::draw_entities(const mat3 &projection, const vec2 &camera_shift, const vec2 &view_size) {
     vec3 headlight_channel = m_light.get_headlight_channel();
-    m_rendering_system.render(projection, camera_shift, headlight_channel);
+    m_light_mask.update(m_light.get_position(), m_light.get_radians());
+    m_rendering_system.render(projection, camera_shift, view_size, headlight_channel, &m_light_mask);
+
+    if (m_print_render_stats) {
+        const RenderStats& stats = m_rendering_system.get_stats();
+        fprintf(stderr, "%d items, %d draw calls, %d state changes, %d redundant state changes removed, %d unlit culled\n",
+                stats.items, stats.draw_calls, stats.state_calls, stats.redundant_calls, stats.unlit_culled);
+        fprintf(stderr, "last frame GL: %d draws, %d binds, %d uniform uploads, %d buffer uploads, %d state changes\n",
+                gl_frame_count(GLCounter::draw_calls), gl_frame_count(GLCounter::binds),
+                gl_frame_count(GLCounter::uniform_uploads), gl_frame_count(GLCounter::buffer_uploads),
+                gl_frame_count(GLCounter::state_changes));
+    }
 }
 
 void Level::draw_light(const mat3 &projection, const vec2 &camera_shift) {
-    m_light.draw(projection, camera_shift, {width, height}, m_torches);
+    m_light.draw(projection, camera_shift, {width, height});
 }
 
 void Level::update(float elapsed_ms) {
@@ -64,8 +101,8 @@ void Level::update(float elapsed_ms) {
 
     m_robot.update_velocity(elapsed_ms);
 
+    vec3 headlight_channel = m_light.get_headlight_channel();
     if (m_has_colour_changed) {
-        vec3 headlight_channel = m_light.get_headlight_channel();
         if (headlight_channel.x == 1.f && headlight_channel.y == 1.f && headlight_channel.z == 1.f) {
             m_graph = &m_white_graph;
         }
@@ -78,8 +115,7 @@ void Level::update(float elapsed_ms) {
         if (headlight_channel.x == 0.f && headlight_channel.y == 0.f && headlight_channel.z == 1.f) {
             m_graph = &m_blue_graph;
         }
-        for (auto &brick_element : m_brick_map) {
-            Brick* i_brick = brick_element.second;
+        for (auto &i_brick : m_tiles.get_bricks()) {
             i_brick->update(headlight_channel);
         }
 
@@ -94,134 +130,43 @@ void Level::update(float elapsed_ms) {
     vec2 new_robot_pos = m_robot.get_next_position(elapsed_ms);
     vec2 new_robot_head_pos = m_robot.get_next_head_position(new_robot_pos);
 
-    float translation = new_robot_pos.x - robot_pos.x;
-    float translation_head = new_robot_head_pos.x - robot_head_pos.x;
-    // get possible brick collision points after trying to move in x dir
-    std::vector<vec2> possible_brick_collisions = get_brick_positions_around_pos({new_robot_pos.x, robot_pos.y});
-
-    for (auto& pos : possible_brick_collisions) {
-        Hitbox robot_hitbox_x = m_robot.get_hitbox();
-        robot_hitbox_x.translate({translation, 0.f});
-        Hitbox robot_head_hitbox_x = m_robot.get_head_hitbox();
-        robot_head_hitbox_x.translate({ translation_head, 0.f});
-        if (m_brick_map.find(pos) == m_brick_map.end()) {
-            // pos was not in the brick map. Therefore, there is no brick at pos, so no collision possible
-            continue;
-        }
-        Brick brick = *m_brick_map[pos];
-        bool should_check_collisions = brick.get_is_collidable();
-        if (should_check_collisions) {
-            if (brick.get_hitbox().collides_with(robot_hitbox_x)) {
-                vec2 vel = m_robot.get_velocity();
-                if (std::abs(vel.x) >= COLLISION_SOUND_MIN_VEL) {
-                    sound_system->play_sound_effect(Sound_Effects::collision);
-                }
-                m_robot.set_velocity({0.f, vel.y});
-
-                float circle_width = brick_size / 2.f;
-                if (abs(m_robot.get_position().y - brick.get_position().y) > brick_size / 2.f) {
-                    float param = abs(m_robot.get_position().y - brick.get_position().y) - brick_size / 2.f;
-                    float dist_no_sqrt = pow(brick_size / 2.f, 2.f) - pow(param, 2.f);
-                    if (dist_no_sqrt >= 0.f)
-                        circle_width = sqrt(dist_no_sqrt);
-                }
-
-                new_robot_pos.x = get_closest_point(robot_pos.x, brick.get_position().x, circle_width,
-                                                    brick_size / 2.f);
-                translation = new_robot_pos.x - robot_pos.x;
-            }
-
-
-            if (brick.get_hitbox().collides_with(robot_head_hitbox_x)) {
-                vec2 head_vel = m_robot.get_head_velocity();
-                if (std::abs(head_vel.x) >= COLLISION_SOUND_MIN_VEL) {
-                    sound_system->play_sound_effect(Sound_Effects::collision);
-                }
-                m_robot.set_head_velocity({0.f, head_vel.y});
-
-                float circle_width = brick_size / 2.f;
-                if (abs(m_robot.get_head_position().y - brick.get_position().y) > brick_size / 2.f) {
-                    float param = abs(m_robot.get_head_position().y - brick.get_position().y) - brick_size / 2.f;
-                    float dist_no_sqrt = pow(brick_size / 2.f, 2.f) - pow(param, 2.f);
-                    if (dist_no_sqrt >= 0.f)
-                        circle_width = sqrt(dist_no_sqrt);
-                }
-
-                new_robot_head_pos.x = get_closest_point(robot_head_pos.x, brick.get_position().x, circle_width,
-                                                         21);
-                translation_head = new_robot_head_pos.x - robot_head_pos.x;
-            }
+    // sweep the body and head to where they are heading along with every other body, sliding along the bricks
+    // they hit on the way
+    KinematicBody& body = m_bodies.get(m_robot_body);
+    body.position = robot_pos;
+    body.motion = sub(new_robot_pos, robot_pos);
+    body.velocity = m_robot.get_velocity();
+    KinematicBody& head = m_bodies.get(m_robot_head);
+    head.position = robot_head_pos;
+    head.motion = sub(new_robot_head_pos, robot_head_pos);
+    head.velocity = m_robot.get_head_velocity();
+    update_stress_bodies(elapsed_ms);
+
+    auto solve_start = std::chrono::high_resolution_clock::now();
+    m_bodies.solve(m_tiles, headlight_channel);
+    auto solve_end = std::chrono::high_resolution_clock::now();
+
+    if (body.impact_speed >= COLLISION_SOUND_MIN_VEL || head.impact_speed >= COLLISION_SOUND_MIN_VEL) {
+        sound_system->play_sound_effect(Sound_Effects::collision);
+    }
+    m_robot.set_velocity(body.velocity);
+    m_robot.set_head_velocity(head.velocity);
+    new_robot_pos = body.position;
+    new_robot_head_pos = head.position;
+
+    if (!m_stress_bodies.empty()) {
+        m_solve_ms += std::chrono::duration_cast<std::chrono::microseconds>(solve_end - solve_start).count() / 1000.f;
+        if (++m_solve_ticks == STRESS_REPORT_TICKS) {
+            fprintf(stderr, "kinematic solver: %d bodies, %.3f ms per tick\n", m_bodies.size(), m_solve_ms / m_solve_ticks);
+            m_solve_ms = 0.f;
+            m_solve_ticks = 0;
         }
     }
 
-    m_robot.set_position({new_robot_pos.x, robot_pos.y});
-    m_robot.set_head_position({new_robot_head_pos.x, robot_head_pos.y});
-
-    translation = new_robot_pos.y - robot_pos.y;
-    translation_head = new_robot_head_pos.y - robot_head_pos.y;
-    // get possible brick collision points after trying to move in y dir
-    possible_brick_collisions = get_brick_positions_around_pos({robot_pos.x, new_robot_pos.y});
-
-    for (auto& pos : possible_brick_collisions) {
-        Hitbox robot_hitbox_y = m_robot.get_hitbox();
-        robot_hitbox_y.translate({0.f, translation});
-        Hitbox robot_head_hitbox_y = m_robot.get_head_hitbox();
-        robot_head_hitbox_y.translate({0.f, translation_head });
-        if (m_brick_map.find(pos) == m_brick_map.end()) {
-            // pos was not in the brick map. Therefore, there is no brick at pos, so no collision possible
-            continue;
-        }
-        Brick brick = *m_brick_map[pos];
-        bool should_check_collisions = brick.get_is_collidable();
-        if (should_check_collisions) {
-            if (brick.get_hitbox().collides_with(robot_hitbox_y)) {
-                vec2 vel = m_robot.get_velocity();
-                if (std::abs(vel.y) >= COLLISION_SOUND_MIN_VEL) {
-                    sound_system->play_sound_effect(Sound_Effects::collision);
-                }
-                m_robot.set_velocity({vel.x, 0.f});
-
-                float circle_width = brick_size / 2.f;
-                if (abs(m_robot.get_position().x - brick.get_position().x) > brick_size / 2.f) {
-                    float param = abs(m_robot.get_position().x - brick.get_position().x) - brick_size / 2.f;
-                    float dist_no_sqrt = pow(brick_size / 2.f, 2.f) - pow(param, 2.f);
-                    if (dist_no_sqrt >= 0.f)
-                        circle_width = sqrt(dist_no_sqrt);
-                }
-
-                new_robot_pos.y = get_closest_point(robot_pos.y, brick.get_position().y, circle_width,
-                                                    brick_size / 2.f);
-                translation = new_robot_pos.y - robot_pos.y;
-                if (brick.get_position().y > new_robot_pos.y) {
-                    m_robot.set_grounded();
-                }
-            }
-
-            if (brick.get_hitbox().collides_with(robot_head_hitbox_y)) {
-                vec2 head_vel = m_robot.get_head_velocity();
-                if (std::abs(head_vel.y) >= COLLISION_SOUND_MIN_VEL) {
-                    sound_system->play_sound_effect(Sound_Effects::collision);
-                }
-                m_robot.set_head_velocity({head_vel.x, 0.f});
-
-                float circle_width = brick_size / 2.f;
-                if (abs(m_robot.get_head_position().x - brick.get_position().x) > brick_size / 2.f) {
-                    float param = abs(m_robot.get_head_position().x - brick.get_position().x) - brick_size / 2.f;
-                    float dist_no_sqrt = pow(brick_size / 2.f, 2.f) - pow(param, 2.f);
-                    if (dist_no_sqrt >= 0.f)
-                        circle_width = sqrt(dist_no_sqrt);
-                }
-
-                new_robot_head_pos.y = get_closest_point(robot_head_pos.y, brick.get_position().y, circle_width,
-                                                         21);
-                translation_head = new_robot_head_pos.y - robot_head_pos.y;
-            }
-        }
-        Music level_bgm = get_level_music();
-        if (level_bgm != prev_bgm) {
-            sound_system->play_bgm(level_bgm);
-            prev_bgm = level_bgm;
-        }
+    Music level_bgm = get_level_music();
+    if (level_bgm != prev_bgm) {
+        sound_system->play_bgm(level_bgm);
+        prev_bgm = level_bgm;
     }
 
     m_robot.set_position(new_robot_pos);
@@ -231,35 +176,159 @@ void Level::update(float elapsed_ms) {
 
     m_robot.set_head_direction(m_light.get_direction());
 
-    Hitbox new_robot_hitbox = m_robot.get_hitbox();
+    const Hitbox& new_robot_hitbox = m_robot.get_hitbox();
 
-    for (auto &ghost : m_ghosts) {
+    for (size_t i = 0; i < m_ghosts.size(); i++) {
+        Ghost* ghost = m_ghosts[i];
         ghost->set_goal(m_robot.get_position());
         ghost->update(elapsed_ms);
-        if (ghost->get_hitbox().collides_with(new_robot_hitbox)) {
+        update_broadphase(m_ghost_handles[i], ghost->get_hitbox());
+    }
+
+    // only the ghosts, signs and doors around the robot are tested against it
+    for (const SpatialHash::Entry& entry : find_touching(new_robot_hitbox)) {
+        if (entry.kind == SpatialHash::Kind::ghost) {
             sound_system->play_sound_effect(Sound_Effects::robot_hurt);
             reset_level();
+            break;
         }
     }
 
-    for (auto &sign : m_signs) {
-        if (sign->get_hitbox().collides_with(new_robot_hitbox))
-            sign->show_text();
-        else
-            sign->hide_text();
+    for (auto &sign : m_shown_signs) {
+        sign->hide_text();
+    }
+    m_shown_signs.clear();
+
+    // the robot may have been sent back by a ghost
+    const Hitbox& robot_hitbox = m_robot.get_hitbox();
+    bool keep_interactable = m_interactable != NULL && m_interactable->get_hitbox().collides_with(robot_hitbox);
+    int first_interactable = -1;
+    for (const SpatialHash::Entry& entry : find_touching(robot_hitbox)) {
+        if (entry.kind == SpatialHash::Kind::sign) {
+            m_signs[entry.index]->show_text();
+            m_shown_signs.push_back(m_signs[entry.index]);
+        }
+        if (entry.kind == SpatialHash::Kind::door && !keep_interactable &&
+            (first_interactable < 0 || entry.index < first_interactable)) {
+            first_interactable = entry.index;
+        }
     }
 
-    const Hitbox robot_hitbox = m_robot.get_hitbox();
     // only check collision with interactable if there is no current interactable or if the current interactable
     // isn't being interacted with
-    if (m_interactable == NULL || !m_interactable->get_hitbox().collides_with(robot_hitbox)) {
-        m_interactable = NULL;
-        for (auto &interactable : m_interactables) {
-            if (interactable->get_hitbox().collides_with(robot_hitbox)) {
-                m_interactable = interactable;
-                break;
+    if (!keep_interactable) {
+        m_interactable = first_interactable < 0 ? NULL : m_interactables[first_interactable];
+    }
+}
+
+void Level::build_broadphase()
+{
+    m_broadphase.clear();
+    m_ghost_handles.clear();
+    m_shown_signs.clear();
+
+    vec2 min, max;
+    for (size_t i = 0; i < m_ghosts.size(); i++) {
+        m_ghosts[i]->get_hitbox().get_bounds(min, max);
+        m_ghost_handles.push_back(m_broadphase.insert(SpatialHash::Kind::ghost, (int)i, min, max));
+    }
+    for (size_t i = 0; i < m_signs.size(); i++) {
+        m_signs[i]->get_hitbox().get_bounds(min, max);
+        m_broadphase.insert(SpatialHash::Kind::sign, (int)i, min, max);
+    }
+    for (size_t i = 0; i < m_interactables.size(); i++) {
+        m_interactables[i]->get_hitbox().get_bounds(min, max);
+        m_broadphase.insert(SpatialHash::Kind::door, (int)i, min, max);
+    }
+}
+
+void Level::update_broadphase(SpatialHash::Handle handle, const Hitbox& hitbox)
+{
+    vec2 min, max;
+    hitbox.get_bounds(min, max);
+    m_broadphase.update(handle, min, max);
+}
+
+const std::vector<SpatialHash::Entry>& Level::find_touching(const Hitbox& hitbox)
+{
+    vec2 min, max;
+    hitbox.get_bounds(min, max);
+    const std::vector<SpatialHash::Entry>& candidates = m_broadphase.query(min, max);
+
+    // the candidates' shapes fill a batch at a time, the range of each one's bits is kept to read its result
+    m_touching.clear();
+    size_t next = 0;
+    while (next < candidates.size()) {
+        size_t first = next;
+        int circle_end[ShapeBatch::CAPACITY];
+        int box_end[ShapeBatch::CAPACITY];
+        m_shape_batch.clear();
+        while (next < candidates.size() && next - first < ShapeBatch::CAPACITY &&
+               get_entry_hitbox(candidates[next]).add_to_batch(m_shape_batch)) {
+            circle_end[next - first] = m_shape_batch.get_circle_count();
+            box_end[next - first] = m_shape_batch.get_box_count();
+            next++;
+        }
+
+        uint32_t circles = 0;
+        uint32_t boxes = 0;
+        hitbox.touching(m_shape_batch, circles, boxes);
+        int circle_first = 0;
+        int box_first = 0;
+        for (size_t i = first; i < next; i++) {
+            if ((circles & bits_between(circle_first, circle_end[i - first])) != 0 ||
+                (boxes & bits_between(box_first, box_end[i - first])) != 0) {
+                m_touching.push_back(candidates[i]);
             }
+            circle_first = circle_end[i - first];
+            box_first = box_end[i - first];
+        }
+    }
+    return m_touching;
+}
+
+const Hitbox& Level::get_entry_hitbox(const SpatialHash::Entry& entry) const
+{
+    switch (entry.kind) {
+    case SpatialHash::Kind::ghost:
+        return m_ghosts[entry.index]->get_hitbox();
+    case SpatialHash::Kind::sign:
+        return m_signs[entry.index]->get_hitbox();
+    default:
+        return m_interactables[entry.index]->get_hitbox();
+    }
+}
+
+void Level::spawn_stress_bodies(int count)
+{
+    // dropped in the empty cells of the level, heading anywhere
+    int spawned = 0;
+    for (int attempt = 0; spawned < count && attempt < count * 10; attempt++) {
+        int x = rand() % (int)width;
+        int y = rand() % (int)height;
+        if (m_tiles.at(x, y) != nullptr) {
+            continue;
         }
+
+        KinematicBody prop;
+        prop.radius = STRESS_BODY_RADIUS;
+        prop.position = to_pixel_position({(float)x, (float)y});
+        prop.velocity = {(rand() / (float)RAND_MAX * 2.f - 1.f) * STRESS_BODY_SPEED,
+                         (rand() / (float)RAND_MAX * 2.f - 1.f) * STRESS_BODY_SPEED};
+        prop.restitution = 0.8f;
+        m_stress_bodies.push_back(m_bodies.add(prop));
+        spawned++;
+    }
+    fprintf(stderr, "%lu stress bodies\n", (long unsigned int)m_stress_bodies.size());
+}
+
+void Level::update_stress_bodies(float elapsed_ms)
+{
+    // fall like the robot does, velocities are in pixels per 100ms
+    for (KinematicSolver::Handle handle : m_stress_bodies) {
+        KinematicBody& prop = m_bodies.get(handle);
+        prop.velocity.y += STRESS_GRAVITY * elapsed_ms / 1000.f;
+        prop.motion = mul(prop.velocity, elapsed_ms / 100.f);
     }
 }
 
@@ -271,26 +340,6 @@ void Level::update_background(float elapsed_ms, vec2 pos_diff)
 	}
 }
 
-std::vector<vec2> Level::get_brick_positions_around_pos(vec2 pos) const {
-    // round the pos to the nearest brick position
-    pos = {floor(pos.x / brick_size) * brick_size, floor(pos.y / brick_size) * brick_size};
-
-    // get the square of bricks around and at pos
-    std::vector<vec2> brick_positions{
-        pos,
-        add(pos, {0, brick_size}), // brick under pos
-        sub(pos, {0, brick_size}), // brick above pos
-        add(pos, {brick_size, 0}), // brick to right of pos
-        sub(pos, {brick_size, 0}), // brick to left of pos
-        add(pos, {brick_size, brick_size}), // brick diagonal (down + right)
-        sub(pos, {brick_size, brick_size}), // brick diagonal (up + left)
-        add(pos, {brick_size, -brick_size}), // brick diagonal (up + right)
-        add(pos, {-brick_size, brick_size}), // brick diagonal (down + left)
-    };
-
-    return brick_positions;
-}
-
 vec2 Level::get_starting_camera_position() const {
     return m_starting_camera_pos;
 }
@@ -327,8 +376,9 @@ bool Level::parse_level(std::string level, std::vector<std::string> unlocked, ve
     // clear all level-dependent resources
     destroy();
 
-    // Parse the json
-    json j = json::parse(file);
+    // Parse the json, the source is kept to key the baked torch light
+    std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    json j = json::parse(source);
 
     width = j["size"]["width"];
     height = j["size"]["height"];
@@ -393,6 +443,7 @@ bool Level::parse_level(std::string level, std::vector<std::string> unlocked, ve
                                {-1.f, 1.f},
                                {1.f,  1.f}};
 
+    m_tiles.init((int)width, (int)height);
     std::vector<bool> empty((int)width, false);
     std::vector<std::vector<bool>> bricks((int)height, empty);
     std::vector<std::vector<bool>> white_bricks((int)height, empty);
@@ -433,7 +484,30 @@ bool Level::parse_level(std::string level, std::vector<std::string> unlocked, ve
 
     fprintf(stderr, "	built world with %lu doors, %lu ghosts, and %lu bricks\n",
 		(long unsigned int)m_interactables.size(), (long unsigned int)m_ghosts.size(), 
-		(long unsigned int)m_brick_map.size());
+		(long unsigned int)m_tiles.get_bricks().size());
+
+    // White bricks are the only light occluders
+    m_distance_field.build(white_bricks, (int)width, (int)height);
+    fprintf(stderr, "	built %dx%d distance field\n", m_distance_field.get_width(), m_distance_field.get_height());
+
+    // Torches never move, their light is only baked again when the level changes
+    std::string lightmap_path = level_path;
+    lightmap_path.append(level).append(".lightmap");
+    uint64_t source_hash = TorchLightmap::content_hash(source);
+    if (m_torch_lightmap.load(lightmap_path, source_hash)) {
+        fprintf(stderr, "	loaded torch lightmap\n");
+    } else {
+        std::vector<vec2> torch_positions;
+        for (Torch* torch : m_torches) {
+            torch_positions.push_back(torch->get_position());
+        }
+        m_torch_lightmap.bake(m_distance_field, torch_positions, (int)width, (int)height);
+        fprintf(stderr, "	baked %dx%d torch lightmap\n", m_torch_lightmap.get_width(), m_torch_lightmap.get_height());
+        if (!m_torch_lightmap.save(lightmap_path, source_hash)) {
+            fprintf(stderr, "	failed to cache torch lightmap in %s\n", lightmap_path.c_str());
+        }
+    }
+    m_light_mask.init(m_torch_lightmap, (int)width, (int)height);
 
     // Generate the graph
     if (m_ghosts.size() > 0)
@@ -458,16 +532,38 @@ bool Level::parse_level(std::string level, std::vector<std::string> unlocked, ve
 	}
     spawn_robot(to_pixel_position(robot_pos));
 
+    KinematicBody robot_body;
+    robot_body.radius = ROBOT_RADIUS;
+    robot_body.owner = &m_robot;
+    robot_body.on_grounded = [](void* robot) { ((Robot*)robot)->set_grounded(); };
+    m_robot_body = m_bodies.add(robot_body);
+    KinematicBody robot_head;
+    robot_head.radius = ROBOT_HEAD_RADIUS;
+    m_robot_head = m_bodies.add(robot_head);
+
+    if (!m_light.set_occupancy(white_bricks, (int)width, (int)height)) {
+        fprintf(stderr, "	occupancy upload failed\n");
+    }
+    if (!m_light.set_distance_field(m_distance_field)) {
+        fprintf(stderr, "	distance field upload failed\n");
+    }
+    if (!m_light.set_torch_lightmap(m_torch_lightmap)) {
+        fprintf(stderr, "	torch lightmap upload failed\n");
+    }
+
 	for (auto& background : m_backgrounds) {
 		background->set_position(to_pixel_position(robot_pos));
 	}
 
+    build_broadphase();
     save_level();
 
     m_rendering_system.process(min, next_id);
 
 	m_has_colour_changed = true;
 
+    fprintf(stderr, "	%lu shader programs live\n", (long unsigned int)Effect::live_programs());
+
     return true;
 }
 
@@ -503,6 +599,20 @@ std::string Level::handle_key_press(int key, int action, std::unordered_map<int,
         return interact();
     }
 
+    if (action == GLFW_PRESS && key == GLFW_KEY_F3) {
+        m_print_render_stats = !m_print_render_stats;
+    }
+
+    // Checks the CPU lighting backend against light.fs.glsl on the next frame
+    if (action == GLFW_PRESS && key == GLFW_KEY_F4) {
+        m_light.request_comparison();
+    }
+
+    // Loads the kinematic solver with more bodies, its time per tick is printed while they are around
+    if (action == GLFW_PRESS && key == GLFW_KEY_F5) {
+        spawn_stress_bodies(STRESS_BODY_COUNT);
+    }
+
     // headlight toggle
     if (action == GLFW_PRESS && key == GLFW_KEY_1) {
         m_light.set_red_channel();
@@ -605,7 +715,7 @@ bool Level::spawn_robot(vec2 position)
         m_robot.set_position(position);
         m_robot.set_head_position(position);
         m_robot.set_shoulder_position(position);
-        if (m_light.init(m_level)) {
+        if (m_light.init()) {
             m_light.set_position(m_robot.get_head_position());
         }
         return true;
@@ -660,7 +770,9 @@ bool Level::spawn_brick(vec2 position, vec3 colour) {
     if (brick->init(next_id++, colour))
     {
         brick->set_position(position);
-        m_brick_map.insert({position, brick});
+        if (!m_tiles.insert(brick)) {
+            fprintf(stderr, "	brick at %.0f, %.0f is outside the level or on another brick\n", position.x, position.y);
+        }
         return true;
     }
     fprintf(stderr, "	brick spawn failed\n");
@@ -678,8 +790,9 @@ void Level::save_level() {
 void Level::reset_level() {
     int pos_i = 0;
     m_robot.set_position(reset_positions[pos_i++]);
-    for (auto &ghost : m_ghosts) {
-        ghost->set_position(reset_positions[pos_i++]);
+    for (size_t i = 0; i < m_ghosts.size(); i++) {
+        m_ghosts[i]->set_position(reset_positions[pos_i++]);
+        update_broadphase(m_ghost_handles[i], m_ghosts[i]->get_hitbox());
     }
 }
 
@@ -2,6 +2,10 @@
 
 #include "common.hpp"
 #include "brick.hpp"
+#include "tile_grid.hpp"
+#include "kinematic_solver.hpp"
+#include "spatial_hash.hpp"
+#include "shape_batch.hpp"
 #include "Robot/robot.hpp"
 #include "ghost.hpp"
 #include "level_graph.hpp"
@@ -21,7 +25,7 @@ class Level
     public:
     // Renders level
     // projection is the 2D orthographic projection matrix
-	void draw_entities(const mat3& projection, const vec2& camera_shift);
+	void draw_entities(const mat3& projection, const vec2& camera_shift, const vec2& view_size);
     void draw_light(const mat3& projection, const vec2& camera_shift);
 
     // Releases all level-associated resources
@@ -73,12 +77,20 @@ private:
 	bool spawn_background();
 	bool spawn_torch(vec2 position);
 
+	// Adds count bodies in empty cells to load the kinematic solver
+	void spawn_stress_bodies(int count);
+	void update_stress_bodies(float elapsed_ms);
+
 	// get the closest ghost to the robot
 	float get_min_ghost_distance();
 	Music prev_bgm = Music::standard;
 
-	// returns the square of bricks around and at pos. Used for collision checking
-	std::vector<vec2> get_brick_positions_around_pos(vec2 pos) const;
+	// Registers the ghosts, signs and doors in the broadphase
+	void build_broadphase();
+	void update_broadphase(SpatialHash::Handle handle, const Hitbox& hitbox);
+	// Broadphase entries whose hitbox collides with the given one, tested in batches
+	const std::vector<SpatialHash::Entry>& find_touching(const Hitbox& hitbox);
+	const Hitbox& get_entry_hitbox(const SpatialHash::Entry& entry) const;
 
 	// For resetting the level
 	void save_level();
@@ -91,24 +103,37 @@ private:
 
 	// Light effect
 	Light m_light;
-
-	// Data structure for unordered_map, using vec2 as key
-	struct vec2Hash {
-		std::size_t operator()(const vec2& v) const
-		{
-			return std::hash<std::string>()(std::to_string(v.x) + "," + std::to_string(v.y));
-		}
-	};
+	// Distance to the nearest white brick, shadow rays are sphere traced through it
+	DistanceField m_distance_field;
+	// Light of every torch, baked once per level and cached next to it
+	TorchLightmap m_torch_lightmap;
+	// Bricks any light reaches, sprites elsewhere are not drawn
+	LightMask m_light_mask;
 
     // Level entities
     Robot m_robot;
-	std::unordered_map<vec2, Brick*, vec2Hash> m_brick_map;
+	TileGrid m_tiles;
+	// Every body moved through the bricks, the robot's body and head among them
+	KinematicSolver m_bodies;
+	KinematicSolver::Handle m_robot_body;
+	KinematicSolver::Handle m_robot_head;
+	// Added with F5 to load the solver
+	std::vector<KinematicSolver::Handle> m_stress_bodies;
+	float m_solve_ms = 0.f;
+	int m_solve_ticks = 0;
 	std::vector<Ghost*> m_ghosts;
     std::vector<Door*> m_interactables;
 	std::vector<Sign*> m_signs;
 	std::vector<Background*> m_backgrounds;
 	std::vector<Torch*> m_torches;
 
+	// Ghosts, signs and doors by where they are, only those near the robot are tested against it
+	SpatialHash m_broadphase;
+	std::vector<SpatialHash::Handle> m_ghost_handles;
+	std::vector<Sign*> m_shown_signs;
+	ShapeBatch m_shape_batch;
+	std::vector<SpatialHash::Entry> m_touching;
+
 	vec2 m_starting_camera_pos;
 
     LevelGraph* m_graph;
@@ -124,4 +149,7 @@ private:
 
 	double m_scroll_amount = 0;
 	bool m_scroll_down = false;
+
+	// Toggled with F3, prints the rendering system's per frame counters
+	bool m_print_render_stats = false;
 };
@@ -1,12 +1,73 @@
 #include "light.hpp"
-#include "torch.hpp"
+#include "gl_debug.hpp"
 #include <math.h>
 #include <iostream>
 #include <string>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 
-std::map<std::string, Texture> Light::brickmap_textures;
+namespace
+{
+    // Width of the shadow map, SHADOW_MAP_ANGLES in shadow_map.fs.glsl
+    const int SHADOW_MAP_ANGLES = 1024;
+
+    // Furthest light.fs.glsl looks up the headlight
+    const float HEADLIGHT_RANGE = 800.f;
+
+    // Half width of the headlight cone, max_diff in light.fs.glsl
+    const float CONE_HALF_ANGLE = 3.1415f / 8;
+
+    const float PI = 3.14159265f;
+
+    bool same(const vec2& a, const vec2& b)
+    {
+        return a.x == b.x && a.y == b.y;
+    }
+
+    bool same(const vec3& a, const vec3& b)
+    {
+        return a.x == b.x && a.y == b.y && a.z == b.z;
+    }
+
+    // Grows the box min_corner, max_corner over the headlight cone at angle, in screen pixels
+    void add_cone_bounds(vec2 apex, float angle, vec2& min_corner, vec2& max_corner)
+    {
+        // light.fs.glsl points the cone along (cos, -sin), y growing downwards. A small slack covers the
+        // difference between the shader's acos and the exact edge.
+        float centre = -angle;
+        float half_angle = CONE_HALF_ANGLE + 0.01f;
+        float low = centre - half_angle;
+        float high = centre + half_angle;
+
+        // The arc reaches furthest along an axis where it crosses that axis' direction
+        float edges[2 + 17] = { low, high };
+        int edge_count = 2;
+        for (int quarter = -8; quarter <= 8; quarter++)
+        {
+            float axis = quarter * PI / 2;
+            if (axis > low && axis < high)
+                edges[edge_count++] = axis;
+        }
+
+        min_corner = { std::min(min_corner.x, apex.x), std::min(min_corner.y, apex.y) };
+        max_corner = { std::max(max_corner.x, apex.x), std::max(max_corner.y, apex.y) };
+        for (int i = 0; i < edge_count; i++)
+        {
+            vec2 p = { apex.x + cosf(edges[i]) * HEADLIGHT_RANGE, apex.y + sinf(edges[i]) * HEADLIGHT_RANGE };
+            min_corner = { std::min(min_corner.x, p.x), std::min(min_corner.y, p.y) };
+            max_corner = { std::max(max_corner.x, p.x), std::max(max_corner.y, p.y) };
+        }
+    }
 
-bool Light::init(std::string level) {
+    // Light terms texel whose centre lies at pixel along one axis, inverse of texel_to_pixel in light_reference.cpp
+    float pixel_to_texel(float pixel, int texels, int pixels)
+    {
+        return (pixel / pixels * 2.1f - 0.05f) / 2.f * texels - 0.5f;
+    }
+}
+
+bool Light::init() {
     // Since we are not going to apply transformation to this screen geometry
     // The coordinates are set to fill the standard openGL window [-1, -1 .. 1, 1]
     // Make the size slightly larger then the screen to crop the boundary.
@@ -22,10 +83,19 @@ bool Light::init(std::string level) {
     // Clearing errors
     gl_flush_errors();
 
+    // Vertex Array holding the screen quad layout, sprite vertex arrays are never left bound for us to modify
+    glGenVertexArrays(1, &mesh.vao);
+    gl_bind_vertex_array(mesh.vao);
+
     // Vertex Buffer creation
     glGenBuffers(1, &mesh.vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(screen_vertex_buffer_data), screen_vertex_buffer_data, GL_STATIC_DRAW);
+    gl_bind_buffer(GL_ARRAY_BUFFER, mesh.vbo);
+    gl_buffer_data(GL_ARRAY_BUFFER, sizeof(screen_vertex_buffer_data), screen_vertex_buffer_data, GL_STATIC_DRAW);
+
+    // Bind to attribute 0 (in_position) as in the vertex shader
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    gl_bind_vertex_array(0);
 
     if (gl_has_errors())
         return false;
@@ -34,23 +104,20 @@ bool Light::init(std::string level) {
     if (!effect.load_from_file(shader_path("light.vs.glsl"), shader_path("light.fs.glsl")))
         return false;
 
-	if (brickmap_textures.find(level) == brickmap_textures.end()
-		|| !brickmap_textures[level].is_valid())
-	{
-		std::string path = shadow_path;
-		path = path.append(level).append("_brickmap.bmp");
-		if (!brickmap_textures[level].load_from_file(path.c_str()))
-		{
-			fprintf(stderr, "Failed to load brickmap texture!");
-			return false;
-		}
-	}
+    // The shadow map pass covers its whole target with the same screen quad
+    if (!m_shadow_effect.load_from_file(shader_path("light.vs.glsl"), shader_path("shadow_map.fs.glsl")))
+        return false;
 
-    m_headlight_channel = {1.f, 1.f, 1.f};
-	rc.texture = &brickmap_textures[level];
+    // Reduced resolution lighting, see lighting_downscale
+    if (!m_terms_effect.load_from_file(shader_path("light.vs.glsl"), shader_path("light.fs.glsl"), "#define LIGHT_TERMS\n"))
+        return false;
+    if (!m_upsample_effect.load_from_file(shader_path("light.vs.glsl"), shader_path("light_upsample.fs.glsl")))
+        return false;
+
+    if (!init_shadow_map())
+        return false;
 
-	if (!rc.init_sprite())
-		return false;
+    m_headlight_channel = {1.f, 1.f, 1.f};
 
     return true;
 }
@@ -58,20 +125,50 @@ bool Light::init(std::string level) {
 // Releases all graphics resources
 void Light::destroy() 
 {
-	for (const auto& it : brickmap_textures)
-	{
-		Texture t = it.second;
-		if (t.id != 0) glDeleteTextures(1, &t.id);
-		if (t.depth_render_buffer_id != 0) glDeleteRenderbuffers(1, &t.depth_render_buffer_id);	
-	}
+    glDeleteBuffers(1, &mesh.vbo);
+    glDeleteVertexArrays(1, &mesh.vao);
+
+    if (m_occupancy != 0)
+    {
+        glDeleteTextures(1, &m_occupancy);
+        m_occupancy = 0;
+    }
+    m_field = nullptr;
+    m_lightmap = nullptr;
 
-	brickmap_textures.clear();
+    if (m_distance_field != 0)
+    {
+        glDeleteTextures(1, &m_distance_field);
+        m_distance_field = 0;
+    }
 
-    glDeleteBuffers(1, &mesh.vbo);
+    if (m_torch_lightmap != 0)
+    {
+        glDeleteTextures(1, &m_torch_lightmap);
+        m_torch_lightmap = 0;
+    }
 
-    glDeleteShader(effect.vertex);
-    glDeleteShader(effect.fragment);
-    glDeleteShader(effect.program);
+    if (m_shadow_frame_buffer != 0)
+    {
+        glDeleteFramebuffers(1, &m_shadow_frame_buffer);
+        glDeleteTextures(1, &m_shadow_map);
+        m_shadow_frame_buffer = 0;
+        m_shadow_map = 0;
+    }
+    m_shadow_effect.release();
+
+    if (m_light_frame_buffer != 0)
+    {
+        glDeleteFramebuffers(1, &m_light_frame_buffer);
+        glDeleteTextures(1, &m_light_terms);
+        m_light_frame_buffer = 0;
+        m_light_terms = 0;
+    }
+    m_light_terms_width = m_light_terms_height = 0;
+    m_terms_effect.release();
+    m_upsample_effect.release();
+
+    effect.release();
 }
 
 // pos is the robot pos
@@ -88,6 +185,11 @@ void Light::set_position(vec2 pos){
 	}
 }
 
+vec2 Light::get_position() const
+{
+    return motion.position;
+}
+
 void Light::convert_mouse_pos_to_rad(vec2 coordinates, vec2 centre) {
     float x = coordinates.x - centre.x;
     float y = -coordinates.y + centre.y;
@@ -119,6 +221,142 @@ void Light::set_ambient(float ambient)
     this->ambient = ambient;
 }
 
+bool Light::set_occupancy(const std::vector<std::vector<bool>>& occupied, int width, int height)
+{
+    std::vector<GLubyte> texels(width * height);
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            texels[y * width + x] = occupied[y][x] ? 255 : 0;
+    m_level_size = { width * brick_size, height * brick_size };
+    m_terms_cached = false;
+
+    gl_flush_errors();
+
+    if (m_occupancy == 0)
+        glGenTextures(1, &m_occupancy);
+
+    // Fetched per brick, never filtered
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    gl_bind_texture(GL_TEXTURE_2D, m_occupancy);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, texels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    gl_bind_texture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    return !gl_has_errors();
+}
+
+bool Light::set_distance_field(const DistanceField& field)
+{
+    gl_flush_errors();
+
+    if (m_distance_field == 0)
+        glGenTextures(1, &m_distance_field);
+
+    // Half floats keep whole pixels up to the clamp distance, filtering interpolates between texel centres
+    m_field = &field;
+    m_terms_cached = false;
+    gl_bind_texture(GL_TEXTURE_2D, m_distance_field);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, field.get_width(), field.get_height(), 0, GL_RED, GL_FLOAT, field.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    gl_bind_texture(GL_TEXTURE_2D, 0);
+
+    return !gl_has_errors();
+}
+
+bool Light::set_torch_lightmap(const TorchLightmap& lightmap)
+{
+    gl_flush_errors();
+
+    if (m_torch_lightmap == 0)
+        glGenTextures(1, &m_torch_lightmap);
+
+    // Rows are tightly packed bytes
+    m_lightmap = &lightmap;
+    m_terms_cached = false;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    gl_bind_texture(GL_TEXTURE_2D, m_torch_lightmap);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, lightmap.get_width(), lightmap.get_height(), 0, GL_RED, GL_UNSIGNED_BYTE, lightmap.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    gl_bind_texture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    return !gl_has_errors();
+}
+
+bool Light::init_shadow_map()
+{
+    gl_flush_errors();
+
+    if (m_shadow_frame_buffer == 0)
+    {
+        glGenFramebuffers(1, &m_shadow_frame_buffer);
+        glGenTextures(1, &m_shadow_map);
+    }
+
+    // A single row, angles wrap around
+    gl_bind_texture(GL_TEXTURE_2D, m_shadow_map);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, SHADOW_MAP_ANGLES, 1, 0, GL_RED, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    gl_bind_texture(GL_TEXTURE_2D, 0);
+
+    GLint frame_buffer;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &frame_buffer);
+    gl_bind_framebuffer(GL_FRAMEBUFFER, m_shadow_frame_buffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_shadow_map, 0);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    gl_bind_framebuffer(GL_FRAMEBUFFER, frame_buffer);
+
+    if (!complete || gl_has_errors())
+    {
+        fprintf(stderr, "Failed to create shadow map\n");
+        return false;
+    }
+
+    return true;
+}
+
+void Light::draw_shadow_map(const GLint viewport[4])
+{
+    // The caller's target is restored once the row is traced
+    GLint frame_buffer;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &frame_buffer);
+
+    gl_bind_framebuffer(GL_FRAMEBUFFER, m_shadow_frame_buffer);
+    glViewport(0, 0, SHADOW_MAP_ANGLES, 1);
+    gl_use_program(m_shadow_effect.program);
+    gl_disable(GL_BLEND);
+    gl_disable(GL_DEPTH_TEST);
+
+    gl_uniform_1i(m_shadow_effect.uniform(Uniform::distance_field), 2);
+    gl_uniform_1f(m_shadow_effect.uniform(Uniform::distance_field_texel), DistanceField::TEXEL_SIZE);
+    glActiveTexture(GL_TEXTURE2);
+    gl_bind_texture(GL_TEXTURE_2D, m_distance_field);
+    glActiveTexture(GL_TEXTURE0);
+
+    float light[] = { motion.position.x, motion.position.y };
+    gl_uniform_2fv(m_shadow_effect.uniform(Uniform::light_position), 1, light);
+    gl_uniform_1f(m_shadow_effect.uniform(Uniform::light_range), HEADLIGHT_RANGE);
+
+    gl_bind_vertex_array(mesh.vao);
+    gl_draw_arrays(GL_TRIANGLES, 0, 6);
+
+    gl_bind_framebuffer(GL_FRAMEBUFFER, frame_buffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
 vec3 Light::get_headlight_channel(){
     return m_headlight_channel;
 }
@@ -171,79 +409,330 @@ void Light::set_prev_light_channel() {
     }
 }
 
-void Light::draw(const mat3& projection, const vec2& camera_shift, const vec2& size, std::vector<Torch*> torches){
+void Light::draw(const mat3& projection, const vec2& camera_shift, const vec2& size){
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    bool cpu = cpu_lighting && m_field != nullptr && m_lightmap != nullptr;
+    bool compare = m_compare_requested && m_field != nullptr && m_lightmap != nullptr;
+    m_compare_requested = false;
+
+    // Light terms rendered apart from the scene, at reduced resolution or by the CPU, then applied to it
+    int terms_width = std::max(viewport[2] / lighting_downscale, 1);
+    int terms_height = std::max(viewport[3] / lighting_downscale, 1);
+    if (init_light_target(terms_width, terms_height))
+    {
+        if (compare)
+        {
+            compare_backends(camera_shift, viewport, terms_width, terms_height);
+            if (cpu)
+                upload_cpu_terms(terms_width, terms_height);
+            m_terms_cached = false;
+        }
+        else
+        {
+            draw_cached_terms(camera_shift, viewport, terms_width, terms_height, cpu);
+        }
+
+        draw_upsample(camera_shift);
+        return;
+    }
+
+    // Occluder distances around the headlight, looked up instead of marching rays per pixel
+    draw_shadow_map(viewport);
+
     // Setting shaders
-    glUseProgram(effect.program);
+    gl_use_program(effect.program);
 
     // Enabling alpha channel for textures
-    glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_DEPTH_TEST);
+    gl_enable(GL_BLEND); gl_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    gl_enable(GL_DEPTH_TEST);
+
+    set_light_uniforms(effect, camera_shift);
+
+    // Draw the screen texture on the quad geometry
+    // Setting vertices
+    gl_bind_vertex_array(mesh.vao);
+
+    // Draw
+    gl_draw_arrays(GL_TRIANGLES, 0, 6); // 2*3 indices starting at 0 -> 2 triangles
+    gl_bind_vertex_array(0);
+}
+
+void Light::draw_cached_terms(const vec2& camera_shift, const GLint viewport[4], int width, int height, bool cpu)
+{
+    LightInputs inputs = get_inputs(camera_shift, viewport);
+    const LightInputs& cached = m_cached_inputs;
+
+    bool unchanged_but_angle = m_terms_cached && cpu == m_cached_cpu &&
+        inputs.screen_width == cached.screen_width && inputs.screen_height == cached.screen_height &&
+        same(inputs.camera_shift, cached.camera_shift) && same(inputs.light_position, cached.light_position) &&
+        same(inputs.headlight_channel, cached.headlight_channel) && same(inputs.level_size, cached.level_size);
+    m_cached_inputs = inputs;
+    m_cached_cpu = cpu;
+    m_terms_cached = true;
+
+    if (unchanged_but_angle && inputs.light_angle == cached.light_angle)
+        return;
+
+    if (cpu)
+    {
+        render_cpu_terms(camera_shift, viewport, width, height);
+        upload_cpu_terms(width, height);
+        return;
+    }
+
+    if (!unchanged_but_angle)
+    {
+        draw_shadow_map(viewport);
+        draw_terms(camera_shift, viewport, width, height);
+        return;
+    }
+
+    // Turning the headlight only changes the light under its old and new cones. The shadow map does not
+    // depend on the angle and is still valid.
+    vec2 apex = add(inputs.light_position, inputs.camera_shift);
+    vec2 min_corner = apex;
+    vec2 max_corner = apex;
+    add_cone_bounds(apex, cached.light_angle, min_corner, max_corner);
+    add_cone_bounds(apex, inputs.light_angle, min_corner, max_corner);
+
+    // Terms rows go bottom up, a texel or two of margin for rounding
+    int x0 = std::max((int)floorf(pixel_to_texel(min_corner.x, width, inputs.screen_width)) - 2, 0);
+    int x1 = std::min((int)ceilf(pixel_to_texel(max_corner.x, width, inputs.screen_width)) + 2, width - 1);
+    int y0 = std::max((int)floorf(pixel_to_texel(inputs.screen_height - max_corner.y, height, inputs.screen_height)) - 2, 0);
+    int y1 = std::min((int)ceilf(pixel_to_texel(inputs.screen_height - min_corner.y, height, inputs.screen_height)) + 2, height - 1);
+    if (x0 > x1 || y0 > y1)
+        return;
+
+    GLint scissor[] = { x0, y0, x1 - x0 + 1, y1 - y0 + 1 };
+    draw_terms(camera_shift, viewport, width, height, scissor);
+}
+
+void Light::draw_terms(const vec2& camera_shift, const GLint viewport[4], int width, int height, const GLint* scissor)
+{
+    GLint frame_buffer;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &frame_buffer);
+
+    // Light terms written as they are
+    gl_bind_framebuffer(GL_FRAMEBUFFER, m_light_frame_buffer);
+    glViewport(0, 0, width, height);
+    gl_disable(GL_BLEND);
+    gl_disable(GL_DEPTH_TEST);
+    if (scissor != nullptr)
+    {
+        gl_enable(GL_SCISSOR_TEST);
+        glScissor(scissor[0], scissor[1], scissor[2], scissor[3]);
+    }
+
+    gl_use_program(m_terms_effect.program);
+    set_light_uniforms(m_terms_effect, camera_shift);
+
+    gl_bind_vertex_array(mesh.vao);
+    gl_draw_arrays(GL_TRIANGLES, 0, 6);
+    gl_bind_vertex_array(0);
+
+    if (scissor != nullptr)
+        gl_disable(GL_SCISSOR_TEST);
+    gl_bind_framebuffer(GL_FRAMEBUFFER, frame_buffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+void Light::draw_upsample(const vec2& camera_shift)
+{
+    // Applied to the scene at full resolution
+    gl_use_program(m_upsample_effect.program);
+    gl_enable(GL_BLEND); gl_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    gl_enable(GL_DEPTH_TEST);
+
+    gl_uniform_1i(m_upsample_effect.uniform(Uniform::screen_texture), 0);
+    gl_uniform_1i(m_upsample_effect.uniform(Uniform::brick_map), 1);
+    gl_uniform_1i(m_upsample_effect.uniform(Uniform::light_terms), 7);
+    float cam[] = { camera_shift.x, camera_shift.y };
+    gl_uniform_2fv(m_upsample_effect.uniform(Uniform::camera_pos), 1, cam);
+    float channel[] = { m_headlight_channel.x, m_headlight_channel.y, m_headlight_channel.z };
+    gl_uniform_3fv(m_upsample_effect.uniform(Uniform::headlight_channel), 1, channel);
+
+    glActiveTexture(GL_TEXTURE1);
+    gl_bind_texture(GL_TEXTURE_2D, m_occupancy);
+    glActiveTexture(GL_TEXTURE7);
+    gl_bind_texture(GL_TEXTURE_2D, m_light_terms);
+    glActiveTexture(GL_TEXTURE0);
+
+    gl_bind_vertex_array(mesh.vao);
+    gl_draw_arrays(GL_TRIANGLES, 0, 6);
+    gl_bind_vertex_array(0);
+}
+
+LightInputs Light::get_inputs(const vec2& camera_shift, const GLint viewport[4])
+{
+    LightInputs inputs;
+    inputs.screen_width = viewport[2];
+    inputs.screen_height = viewport[3];
+    inputs.camera_shift = camera_shift;
+    inputs.light_position = motion.position;
+    inputs.light_angle = motion.radians;
+    inputs.headlight_channel = m_headlight_channel;
+    inputs.level_size = m_level_size;
+    return inputs;
+}
+
+void Light::render_cpu_terms(const vec2& camera_shift, const GLint viewport[4], int width, int height)
+{
+    m_reference.trace_shadows(*m_field, motion.position, HEADLIGHT_RANGE);
+    m_cpu_terms.resize(width * height * 2);
+    m_reference.render_terms(get_inputs(camera_shift, viewport), *m_lightmap, width, height, m_cpu_terms.data());
+}
+
+void Light::upload_cpu_terms(int width, int height)
+{
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    gl_bind_texture(GL_TEXTURE_2D, m_light_terms);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RG, GL_UNSIGNED_BYTE, m_cpu_terms.data());
+    gl_bind_texture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void Light::compare_backends(const vec2& camera_shift, const GLint viewport[4], int width, int height)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    // GL terms, timed to completion
+    glFinish();
+    auto gl_start = Clock::now();
+    draw_shadow_map(viewport);
+    draw_terms(camera_shift, viewport, width, height);
+    glFinish();
+    auto gl_end = Clock::now();
+
+    std::vector<uint8_t> gl_terms(width * height * 2);
+    GLint frame_buffer;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &frame_buffer);
+    gl_bind_framebuffer(GL_FRAMEBUFFER, m_light_frame_buffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RG, GL_UNSIGNED_BYTE, gl_terms.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    gl_bind_framebuffer(GL_FRAMEBUFFER, frame_buffer);
+
+    auto cpu_start = Clock::now();
+    render_cpu_terms(camera_shift, viewport, width, height);
+    auto cpu_end = Clock::now();
+
+    // Half float shadow maps and filtering precision leave a texel or two off
+    const int TOLERANCE = 2;
+    int max_difference = 0;
+    int differing = 0;
+    for (size_t i = 0; i < gl_terms.size(); i++)
+    {
+        int difference = std::abs((int)gl_terms[i] - (int)m_cpu_terms[i]);
+        max_difference = std::max(max_difference, difference);
+        if (difference > TOLERANCE)
+            differing++;
+    }
+
+    fprintf(stderr, "lighting %dx%d: gl %.2f ms, cpu %.2f ms, max difference %d/255, %d of %d terms off by more than %d\n",
+            width, height,
+            std::chrono::duration_cast<std::chrono::microseconds>(gl_end - gl_start).count() / 1000.f,
+            std::chrono::duration_cast<std::chrono::microseconds>(cpu_end - cpu_start).count() / 1000.f,
+            max_difference, differing, (int)gl_terms.size(), TOLERANCE);
+}
 
+void Light::request_comparison()
+{
+    m_compare_requested = true;
+}
+
+void Light::set_light_uniforms(const Effect& light_effect, const vec2& camera_shift)
+{
     // Set screen_texture sampling to texture unit 0
-    // Set clock
-    GLuint screen_text_uloc = glGetUniformLocation(effect.program, "screen_texture");
-    glUniform1i(screen_text_uloc, 0);
+    GLint screen_text_uloc = light_effect.uniform(Uniform::screen_texture);
+    gl_uniform_1i(screen_text_uloc, 0);
 
 	// Set brick_map sampler uniform
-	GLuint brickmap_uloc = glGetUniformLocation(effect.program, "brick_map");
-	glUniform1i(brickmap_uloc, 1);
+	GLint brickmap_uloc = light_effect.uniform(Uniform::brick_map);
+	gl_uniform_1i(brickmap_uloc, 1);
 
 	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, rc.texture->id);
+	gl_bind_texture(GL_TEXTURE_2D, m_occupancy);
+
+	// Set shadow_map sampler uniform
+	gl_uniform_1i(light_effect.uniform(Uniform::shadow_map), 3);
+
+	glActiveTexture(GL_TEXTURE3);
+	gl_bind_texture(GL_TEXTURE_2D, m_shadow_map);
 	glActiveTexture(GL_TEXTURE0);
 
 	// Pass camera position
-	GLuint camera_pos_uloc = glGetUniformLocation(effect.program, "camera_pos");
+	GLint camera_pos_uloc = light_effect.uniform(Uniform::camera_pos);
 	float cam[] = { camera_shift.x, camera_shift.y };
-	glUniform2fv(camera_pos_uloc, 1, cam);
+	gl_uniform_2fv(camera_pos_uloc, 1, cam);
 
     // pass light position as uniform
-    GLuint light_position_uloc = glGetUniformLocation(effect.program, "light_position");
+    GLint light_position_uloc = light_effect.uniform(Uniform::light_position);
     // cast light pos to array so we can pass as uniform, for some reason it doesnt like vectors
     vec2 light_screen_position = add(motion.position, camera_shift);
     float light[] = {light_screen_position.x, light_screen_position.y};
-    glUniform2fv(light_position_uloc, 1, light);
+    gl_uniform_2fv(light_position_uloc, 1, light);
 
     //pass light angle as uniform
-    GLuint light_angle_uloc = glGetUniformLocation(effect.program, "light_angle");
+    GLint light_angle_uloc = light_effect.uniform(Uniform::light_angle);
     float angle = motion.radians;
-    glUniform1f(light_angle_uloc, angle);
+    gl_uniform_1f(light_angle_uloc, angle);
 
     // pass headlight channel
-    GLuint headlight_channel_uloc = glGetUniformLocation(effect.program, "headlight_channel");
+    GLint headlight_channel_uloc = light_effect.uniform(Uniform::headlight_channel);
     float channel[] = {m_headlight_channel.x, m_headlight_channel.y, m_headlight_channel.z};
-    glUniform3fv(headlight_channel_uloc, 1, channel);
-
-	// pass torches size
-	int len = (int)torches.size();
-	GLuint torches_size_uloc = glGetUniformLocation(effect.program, "torches_size");
-	glUniform1i(torches_size_uloc, len);
-
-	// pass all torch positions
-	for (int i = 0; i < len && i < 256; i++) {
-		std::string s = "torches_position[" + std::to_string(i) + "]";
-		GLuint torches_position_uloc = glGetUniformLocation(effect.program, s.c_str());
-		float x = -10000.f, y = -10000.f;
-		if (i < len)
-		{
-			x = torches[i]->get_position().x;
-			y = torches[i]->get_position().y;
-		}
-		float torch[] = { x + camera_shift.x, y + camera_shift.y };
-		glUniform2fv(torches_position_uloc, 1, torch);
-	}
+    gl_uniform_3fv(headlight_channel_uloc, 1, channel);
 
-    // Draw the screen texture on the quad geometry
-    // Setting vertices
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+	// pass the baked torch light
+	gl_uniform_1i(light_effect.uniform(Uniform::torch_lightmap), 4);
+	gl_uniform_1f(light_effect.uniform(Uniform::torch_lightmap_texel), TorchLightmap::TEXEL_SIZE);
 
-    // Bind to attribute 0 (in_position) as in the vertex shader
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	glActiveTexture(GL_TEXTURE4);
+	gl_bind_texture(GL_TEXTURE_2D, m_torch_lightmap);
+	glActiveTexture(GL_TEXTURE0);
+}
 
-    // Draw
-    glDrawArrays(GL_TRIANGLES, 0, 6); // 2*3 indices starting at 0 -> 2 triangles
-    glDisableVertexAttribArray(0);
+bool Light::init_light_target(int width, int height)
+{
+    if (m_light_frame_buffer != 0 && width == m_light_terms_width && height == m_light_terms_height)
+        return true;
+
+    gl_flush_errors();
+
+    if (m_light_frame_buffer == 0)
+    {
+        glGenFramebuffers(1, &m_light_frame_buffer);
+        glGenTextures(1, &m_light_terms);
+    }
+
+    // Sampled texel by texel by the upsample, never filtered
+    gl_bind_texture(GL_TEXTURE_2D, m_light_terms);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8, width, height, 0, GL_RG, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    gl_bind_texture(GL_TEXTURE_2D, 0);
+
+    GLint frame_buffer;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &frame_buffer);
+    gl_bind_framebuffer(GL_FRAMEBUFFER, m_light_frame_buffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_light_terms, 0);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    gl_bind_framebuffer(GL_FRAMEBUFFER, frame_buffer);
+
+    if (!complete || gl_has_errors())
+    {
+        fprintf(stderr, "Failed to create light terms target, lighting the scene directly every frame\n");
+        m_light_terms_width = m_light_terms_height = 0;
+        return false;
+    }
+
+    m_light_terms_width = width;
+    m_light_terms_height = height;
+    m_terms_cached = false;
+    return true;
 }
 
 bool Light::isWhite(vec3 color) {
@@ -2,27 +2,29 @@
 
 #include "common.hpp"
 #include "components.hpp"
-#include "torch.hpp"
+#include "distance_field.hpp"
+#include "torch_lightmap.hpp"
+#include "light_reference.hpp"
 
 #include <vector>
-#include <map>
 
 class Light : public Entity
 {
-	static std::map<std::string, Texture> brickmap_textures;
-
 public:
     // Creates all the associated render resources and default transform
-    bool init(std::string level);
+    bool init();
 
     // Releases all associated resources
     void destroy();
 
     // Renders the water
-    void draw(const mat3& projection, const vec2& camera_shift, const vec2& size, std::vector<Torch*> torches);
+    void draw(const mat3& projection, const vec2& camera_shift, const vec2& size);
 
     void set_position(vec2 pos);
 
+    // Headlight position in world space
+    vec2 get_position() const;
+
     void convert_mouse_pos_to_rad(vec2 coordinates, vec2 centre);
 
     float get_radians();
@@ -34,6 +36,19 @@ public:
     // Sets the ambient light level
     void set_ambient(float ambient);
 
+    // Uploads one texel per brick, set where occupied[y][x] blocks light
+    bool set_occupancy(const std::vector<std::vector<bool>>& occupied, int width, int height);
+
+    // Uploads the occluder distance field shadow rays are traced through, it is also traced by the CPU
+    // backend so must outlive the light
+    bool set_distance_field(const DistanceField& field);
+
+    // Uploads the baked light of the level's torches, also sampled by the CPU backend
+    bool set_torch_lightmap(const TorchLightmap& lightmap);
+
+    // Renders the next frame's light with both backends and reports their timings and differences
+    void request_comparison();
+
     vec3 get_headlight_channel();
 
     void set_red_channel();
@@ -48,7 +63,51 @@ private:
     float ambient = 0.f;
     vec3 m_headlight_channel;
 
-	RenderComponent rc;
+	GLuint m_occupancy = 0;
+	GLuint m_distance_field = 0;
+	GLuint m_torch_lightmap = 0;
+	vec2 m_level_size = { 0.f, 0.f };
+
+	// CPU backend, see cpu_lighting. It renders the light terms the upsample pass applies.
+	LightReference m_reference;
+	const DistanceField* m_field = nullptr;
+	const TorchLightmap* m_lightmap = nullptr;
+	std::vector<uint8_t> m_cpu_terms;
+	bool m_compare_requested = false;
+
+	// Polar shadow map of the headlight, occluder distances by angle. Torches are baked into m_torch_lightmap.
+	GLuint m_shadow_frame_buffer = 0;
+	GLuint m_shadow_map = 0;
+	Effect m_shadow_effect;
+
+	// Target of the lighting pass, reduced in resolution by lighting_downscale. It holds the light terms only,
+	// light_upsample.fs.glsl applies them to the scene at full resolution without crossing brick edges.
+	GLuint m_light_frame_buffer = 0;
+	GLuint m_light_terms = 0;
+	int m_light_terms_width = 0;
+	int m_light_terms_height = 0;
+	Effect m_terms_effect;
+	Effect m_upsample_effect;
+
+	// m_light_terms is kept across frames and only redrawn where its inputs changed. The scene under it is
+	// applied afresh every frame, so animated sprites need no redraw of the light.
+	LightInputs m_cached_inputs;
+	bool m_cached_cpu = false;
+	bool m_terms_cached = false;
+
+	bool init_shadow_map();
+	void draw_shadow_map(const GLint viewport[4]);
+	bool init_light_target(int width, int height);
+	// Uniforms and textures of the light pass, shared by its full and reduced resolution programs
+	void set_light_uniforms(const Effect& light_effect, const vec2& camera_shift);
+	// scissor limits the redraw to x, y, width, height texels of the light terms
+	void draw_terms(const vec2& camera_shift, const GLint viewport[4], int width, int height, const GLint* scissor = nullptr);
+	void draw_cached_terms(const vec2& camera_shift, const GLint viewport[4], int width, int height, bool cpu);
+	void draw_upsample(const vec2& camera_shift);
+	LightInputs get_inputs(const vec2& camera_shift, const GLint viewport[4]);
+	void render_cpu_terms(const vec2& camera_shift, const GLint viewport[4], int width, int height);
+	void upload_cpu_terms(int width, int height);
+	void compare_backends(const vec2& camera_shift, const GLint viewport[4], int width, int height);
 
 	Mesh mesh;
 	Effect effect;
@@ -0,0 +1,103 @@
+#include "light_mask.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+	// Reach of the headlight cone and robot glow in light.fs.glsl
+	const float HEADLIGHT_RANGE = 800.f;
+	const float GLOW_RANGE = 300.f;
+	const float CONE_HALF_ANGLE = 3.1415f / 8.f;
+
+	// The light pass samples the light a few pixels off from where it draws (its quad reaches 5% past the
+	// window) and upsamples reduced resolution lighting, bricks are grown by this to cover both
+	const float MARGIN = brick_size;
+
+	int brick_of(float position)
+	{
+		return (int)std::floor((position + brick_size / 2.f) / brick_size);
+	}
+}
+
+void LightMask::init(const TorchLightmap& torches, int width, int height)
+{
+	m_width = width;
+	m_height = height;
+	m_torch_lit.assign(width * height, 0);
+
+	// Every brick holding a lit texel, grown by a brick for filtering and MARGIN
+	int texels_per_brick = TorchLightmap::TEXELS_PER_BRICK;
+	for (int y = 0; y < torches.get_height(); y++)
+	{
+		for (int x = 0; x < torches.get_width(); x++)
+		{
+			if (torches.data()[y * torches.get_width() + x] == 0)
+				continue;
+
+			int bx = x / texels_per_brick;
+			int by = y / texels_per_brick;
+			for (int ny = std::max(by - 1, 0); ny <= std::min(by + 1, height - 1); ny++)
+				for (int nx = std::max(bx - 1, 0); nx <= std::min(bx + 1, width - 1); nx++)
+					m_torch_lit[ny * width + nx] = 1;
+		}
+	}
+
+	m_lit = m_torch_lit;
+}
+
+void LightMask::update(vec2 light_position, float light_angle)
+{
+	m_lit = m_torch_lit;
+
+	// Radius of a brick grown by MARGIN around its centre
+	float brick_radius = std::sqrt(2.f) * brick_size / 2.f + MARGIN;
+	vec2 cone = { std::cos(light_angle), -std::sin(light_angle) };
+
+	int min_x = std::max(brick_of(light_position.x - HEADLIGHT_RANGE - MARGIN), 0);
+	int min_y = std::max(brick_of(light_position.y - HEADLIGHT_RANGE - MARGIN), 0);
+	int max_x = std::min(brick_of(light_position.x + HEADLIGHT_RANGE + MARGIN), m_width - 1);
+	int max_y = std::min(brick_of(light_position.y + HEADLIGHT_RANGE + MARGIN), m_height - 1);
+
+	for (int y = min_y; y <= max_y; y++)
+	{
+		for (int x = min_x; x <= max_x; x++)
+		{
+			vec2 d = sub({ x * brick_size, y * brick_size }, light_position);
+			float distance = len(d);
+			if (distance - brick_radius >= HEADLIGHT_RANGE)
+				continue;
+
+			// Glow all around, the cone only where the brick overlaps it
+			bool lit = distance - brick_radius < GLOW_RANGE;
+			if (!lit)
+			{
+				float angle = std::acos(std::max(-1.f, std::min(dot(d, cone) / distance, 1.f)));
+				lit = angle - std::asin(std::min(brick_radius / distance, 1.f)) <= CONE_HALF_ANGLE;
+			}
+
+			if (lit)
+				m_lit[y * m_width + x] = 1;
+		}
+	}
+}
+
+bool LightMask::is_lit(vec2 top_left, vec2 bottom_right) const
+{
+	// Nothing is culled before the level is known
+	if (m_lit.empty())
+		return true;
+
+	// Rectangles past the edge take the edge bricks, the light pass samples a little inward of what it draws
+	int min_x = std::max(std::min(brick_of(top_left.x), m_width - 1), 0);
+	int min_y = std::max(std::min(brick_of(top_left.y), m_height - 1), 0);
+	int max_x = std::min(std::max(brick_of(bottom_right.x), 0), m_width - 1);
+	int max_y = std::min(std::max(brick_of(bottom_right.y), 0), m_height - 1);
+
+	for (int y = min_y; y <= max_y; y++)
+		for (int x = min_x; x <= max_x; x++)
+			if (m_lit[y * m_width + x])
+				return true;
+
+	return false;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "common.hpp"
+#include "torch_lightmap.hpp"
+
+#include <vector>
+#include <cstdint>
+
+// Bricks of the level any light can reach this frame. Everything else is multiplied by zero in the light
+// pass, so sprites lying entirely in unlit bricks need not be drawn. Conservative: a brick is lit when
+// light might reach it, headlight occlusion is not considered.
+class LightMask
+{
+public:
+	// width and height in bricks, torches are taken from their baked light
+	void init(const TorchLightmap& torches, int width, int height);
+
+	// Adds the headlight cone and robot glow around the headlight at light_position (world space)
+	void update(vec2 light_position, float light_angle);
+
+	// Whether light can reach any brick overlapping the world space rectangle
+	bool is_lit(vec2 top_left, vec2 bottom_right) const;
+
+private:
+	int m_width = 0;
+	int m_height = 0;
+	std::vector<uint8_t> m_torch_lit; // static, row major
+	std::vector<uint8_t> m_lit; // m_torch_lit and the headlight of the last update
+};
@@ -0,0 +1,272 @@
+#include "light_reference.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIGHT_REFERENCE_SSE
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Constants of light.fs.glsl and shadow_map.fs.glsl
+	const float PI = 3.14159265f;
+	const float HEADLIGHT_RANGE = 800.f;
+	const float ROBOT_GLOW_RANGE = 300.f;
+	const float HEADLIGHT_FADE = 1000.f;
+	const float CONE_HALF_ANGLE = 3.1415f / 8.f;
+	const float BLOCKING_DEPTH = 64.f;
+	const float MAX_INTENSITY = 0.9f;
+	const int MAX_TRACE_STEPS = 128;
+	const float MIN_TRACE_STEP = 2.f;
+
+	// Rows per thread below which threading costs more than it saves
+	const int MIN_ROWS_PER_THREAD = 16;
+
+	// Pixel position of the centre of a light terms texel along one axis, as the screen quad of light.vs.glsl
+	// maps it: uv spans the quad drawn 5% past the window and pos is uv scaled to the scene
+	float texel_to_pixel(float texel, int texels, int pixels)
+	{
+		return ((texel + 0.5f) / texels * 2.f - 1.f + 1.05f) / 2.1f * pixels;
+	}
+
+	uint8_t to_unorm8(float v)
+	{
+		return (uint8_t)(std::max(0.f, std::min(v, 1.f)) * 255.f + 0.5f);
+	}
+
+#ifdef LIGHT_REFERENCE_SSE
+	__m128 select(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	__m128 abs_ps(__m128 v)
+	{
+		return _mm_andnot_ps(_mm_set1_ps(-0.f), v);
+	}
+
+	// Polynomial on [0, 1] reduced by octant, within 1e-5 radians
+	__m128 atan2_ps(__m128 y, __m128 x)
+	{
+		__m128 ax = abs_ps(x);
+		__m128 ay = abs_ps(y);
+		__m128 a = _mm_div_ps(_mm_min_ps(ax, ay), _mm_max_ps(_mm_max_ps(ax, ay), _mm_set1_ps(1e-30f)));
+		__m128 s = _mm_mul_ps(a, a);
+
+		__m128 r = _mm_set1_ps(-0.01172120f);
+		r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(0.05265332f));
+		r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(-0.11643287f));
+		r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(0.19354346f));
+		r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(-0.33262347f));
+		r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(0.99997726f));
+		r = _mm_mul_ps(r, a);
+
+		r = select(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(_mm_set1_ps(PI / 2.f), r), r);
+		r = select(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(PI), r), r);
+		return select(_mm_cmplt_ps(y, _mm_setzero_ps()), _mm_sub_ps(_mm_setzero_ps(), r), r);
+	}
+
+	// Abramowitz and Stegun 4.4.46 for x in [0, 1], within 2e-8 radians
+	__m128 acos_ps(__m128 x)
+	{
+		__m128 r = _mm_set1_ps(-0.0012624911f);
+		r = _mm_add_ps(_mm_mul_ps(r, x), _mm_set1_ps(0.0066700901f));
+		r = _mm_add_ps(_mm_mul_ps(r, x), _mm_set1_ps(-0.0170881256f));
+		r = _mm_add_ps(_mm_mul_ps(r, x), _mm_set1_ps(0.0308918810f));
+		r = _mm_add_ps(_mm_mul_ps(r, x), _mm_set1_ps(-0.0501743046f));
+		r = _mm_add_ps(_mm_mul_ps(r, x), _mm_set1_ps(0.0889789874f));
+		r = _mm_add_ps(_mm_mul_ps(r, x), _mm_set1_ps(-0.2145988016f));
+		r = _mm_add_ps(_mm_mul_ps(r, x), _mm_set1_ps(1.5707963050f));
+		return _mm_mul_ps(r, _mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.f), x)));
+	}
+#endif
+}
+
+void LightReference::trace_shadows(const DistanceField& field, vec2 light_position, float range)
+{
+	// Positions in the field are relative to the top left corner of the level
+	float offset = brick_size / 2.f;
+
+	for (int i = 0; i < SHADOW_ANGLES; i++)
+	{
+		float angle = ((i + 0.5f) / SHADOW_ANGLES - 0.5f) * 2.f * PI;
+		vec2 d = { cosf(angle), sinf(angle) };
+
+		float t = 0.f;
+		for (int step = 0; step < MAX_TRACE_STEPS && t < range; step++)
+		{
+			float clearance = field.sample(light_position.x + t * d.x + offset, light_position.y + t * d.y + offset);
+			if (clearance <= 0.f)
+				break;
+
+			t += std::max(clearance, MIN_TRACE_STEP);
+		}
+
+		m_shadow[i] = std::min(t, range);
+	}
+}
+
+float LightReference::find_light(float angle, float distance) const
+{
+	if (distance < 1.f)
+		return 1.f;
+
+	// Linear filtering between the two closest angles, wrapping around
+	float s = (angle / (2.f * PI) + 0.5f) * SHADOW_ANGLES - 0.5f;
+	float base = std::floor(s);
+	float f = s - base;
+	int i0 = ((int)base % SHADOW_ANGLES + SHADOW_ANGLES) % SHADOW_ANGLES;
+	int i1 = (i0 + 1) % SHADOW_ANGLES;
+	float occluder = m_shadow[i0] * (1.f - f) + m_shadow[i1] * f;
+
+	return 1.f - std::max(0.f, std::min((distance - occluder) / BLOCKING_DEPTH, 1.f));
+}
+
+void LightReference::render_terms(const LightInputs& inputs, const TorchLightmap& lightmap, int width, int height, uint8_t* terms) const
+{
+	int threads = std::min((int)std::thread::hardware_concurrency(), height / MIN_ROWS_PER_THREAD);
+	if (threads <= 1)
+	{
+		render_rows(inputs, lightmap, width, height, 0, height, terms);
+		return;
+	}
+
+	// Bands of rows, the last one on this thread
+	std::vector<std::thread> workers;
+	int rows = (height + threads - 1) / threads;
+	for (int first = 0; first + rows < height; first += rows)
+		workers.emplace_back(&LightReference::render_rows, this, std::cref(inputs), std::cref(lightmap),
+							 width, height, first, first + rows, terms);
+
+	render_rows(inputs, lightmap, width, height, (int)workers.size() * rows, height, terms);
+
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+void LightReference::render_rows(const LightInputs& inputs, const TorchLightmap& lightmap, int width, int height,
+								 int first_row, int end_row, uint8_t* terms) const
+{
+	// Scene coordinates of the headlight, where light.fs.glsl gets light_position
+	vec2 light = add(inputs.light_position, inputs.camera_shift);
+	vec2 cone = { cosf(inputs.light_angle), -sinf(inputs.light_angle) };
+	bool white = inputs.headlight_channel.x == 1.f && inputs.headlight_channel.y == 1.f && inputs.headlight_channel.z == 1.f;
+	float offset = brick_size / 2.f;
+
+	for (int row = first_row; row < end_row; row++)
+	{
+		// Texture rows go up, scene rows go down
+		float pos_y = inputs.screen_height - texel_to_pixel((float)row, height, inputs.screen_height);
+		float world_y = pos_y - inputs.camera_shift.y + offset;
+		uint8_t* out = terms + row * width * 2;
+		bool row_inside = world_y >= 0.f && world_y <= inputs.level_size.y;
+
+		int column = 0;
+#ifdef LIGHT_REFERENCE_SSE
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.f);
+		const __m128 lanes = _mm_set_ps(3.f, 2.f, 1.f, 0.f);
+		const __m128 dy = _mm_set1_ps(pos_y - light.y);
+		float step_x = 2.f / width / 2.1f * inputs.screen_width;
+		float start_x = texel_to_pixel(0.f, width, inputs.screen_width);
+
+		for (; row_inside && column + 4 <= width; column += 4)
+		{
+			__m128 pos_x = _mm_add_ps(_mm_set1_ps(start_x), _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)column), lanes), _mm_set1_ps(step_x)));
+			__m128 world_x = _mm_add_ps(pos_x, _mm_set1_ps(offset - inputs.camera_shift.x));
+			__m128 inside = _mm_and_ps(_mm_cmpge_ps(world_x, zero), _mm_cmple_ps(world_x, _mm_set1_ps(inputs.level_size.x)));
+
+			__m128 dx = _mm_sub_ps(pos_x, _mm_set1_ps(light.x));
+			__m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+			__m128 angle = atan2_ps(dy, dx);
+
+			// Texture lookups stay scalar per lane
+			alignas(16) float lane_world_x[4], lane_angle[4], lane_distance[4], lane_torch[4], lane_lit[4];
+			_mm_store_ps(lane_world_x, world_x);
+			_mm_store_ps(lane_angle, angle);
+			_mm_store_ps(lane_distance, distance);
+			for (int i = 0; i < 4; i++)
+			{
+				lane_torch[i] = lightmap.sample(lane_world_x[i], world_y);
+				lane_lit[i] = lane_distance[i] < HEADLIGHT_RANGE ? find_light(lane_angle[i], lane_distance[i]) : 0.f;
+			}
+			__m128 torch = _mm_load_ps(lane_torch);
+			__m128 lit = _mm_load_ps(lane_lit);
+
+			// Robot glow
+			__m128 glow = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(one, _mm_div_ps(distance, _mm_set1_ps(ROBOT_GLOW_RANGE))), zero));
+			glow = _mm_mul_ps(_mm_min_ps(_mm_mul_ps(glow, _mm_set1_ps(1.f / 1.2f)), one), lit);
+
+			// Headlight cone
+			__m128 inv_distance = _mm_div_ps(one, _mm_max_ps(distance, _mm_set1_ps(1e-6f)));
+			__m128 cosine = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_set1_ps(cone.x)), _mm_mul_ps(dy, _mm_set1_ps(cone.y))), inv_distance);
+			__m128 angle_diff = acos_ps(_mm_max_ps(_mm_min_ps(cosine, one), zero));
+			__m128 in_cone = _mm_cmple_ps(angle_diff, _mm_set1_ps(CONE_HALF_ANGLE));
+			__m128 hl = _mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(one, _mm_div_ps(angle_diff, _mm_set1_ps(CONE_HALF_ANGLE)))),
+								   _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(one, _mm_div_ps(distance, _mm_set1_ps(HEADLIGHT_FADE))), zero)));
+			hl = _mm_mul_ps(_mm_and_ps(in_cone, _mm_min_ps(hl, _mm_set1_ps(0.8f))), lit);
+
+			__m128 intensity, mix;
+			if (white)
+			{
+				intensity = _mm_add_ps(_mm_add_ps(hl, glow), torch);
+				mix = zero;
+			}
+			else
+			{
+				intensity = _mm_add_ps(_mm_max_ps(hl, torch), glow);
+				mix = hl;
+			}
+			intensity = _mm_and_ps(inside, _mm_min_ps(intensity, _mm_set1_ps(MAX_INTENSITY)));
+			mix = _mm_and_ps(inside, mix);
+
+			alignas(16) float lane_intensity[4], lane_mix[4];
+			_mm_store_ps(lane_intensity, intensity);
+			_mm_store_ps(lane_mix, mix);
+			for (int i = 0; i < 4; i++)
+			{
+				out[(column + i) * 2] = to_unorm8(lane_intensity[i]);
+				out[(column + i) * 2 + 1] = to_unorm8(lane_mix[i]);
+			}
+		}
+#endif
+
+		for (; column < width; column++)
+		{
+			float pos_x = texel_to_pixel((float)column, width, inputs.screen_width);
+			float world_x = pos_x - inputs.camera_shift.x + offset;
+			if (!row_inside || world_x < 0.f || world_x > inputs.level_size.x)
+			{
+				out[column * 2] = 0;
+				out[column * 2 + 1] = 0;
+				continue;
+			}
+
+			float torch = lightmap.sample(world_x, world_y);
+
+			float dx = pos_x - light.x;
+			float dy = pos_y - light.y;
+			float distance = sqrtf(dx * dx + dy * dy);
+			float hl = 0.f;
+			float glow = 0.f;
+			if (distance < HEADLIGHT_RANGE)
+			{
+				float lit = find_light(atan2f(dy, dx), distance);
+				glow = std::min(sqrtf(std::max(1.f - distance / ROBOT_GLOW_RANGE, 0.f)) / 1.2f, 1.f) * lit;
+
+				float cosine = distance > 0.f ? (dx * cone.x + dy * cone.y) / distance : 1.f;
+				float angle_diff = acosf(std::max(-1.f, std::min(cosine, 1.f)));
+				if (angle_diff <= CONE_HALF_ANGLE)
+					hl = std::min(sqrtf(1.f - angle_diff / CONE_HALF_ANGLE) * sqrtf(1.f - distance / HEADLIGHT_FADE), 0.8f) * lit;
+			}
+
+			float intensity = white ? hl + glow + torch : std::max(hl, torch) + glow;
+			out[column * 2] = to_unorm8(std::min(intensity, MAX_INTENSITY));
+			out[column * 2 + 1] = to_unorm8(white ? 0.f : hl);
+		}
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "common.hpp"
+#include "distance_field.hpp"
+#include "torch_lightmap.hpp"
+
+#include <cstdint>
+
+// Everything light.fs.glsl reads to light one frame
+struct LightInputs
+{
+	int screen_width = 0; // scene framebuffer, screen_size in the shader
+	int screen_height = 0;
+	vec2 camera_shift;
+	vec2 light_position; // world space
+	float light_angle = 0.f;
+	vec3 headlight_channel;
+	vec2 level_size; // pixels, the extent of the occupancy texture
+};
+
+// CPU implementation of the lighting model of light.fs.glsl and shadow_map.fs.glsl, vectorised over four pixels
+// of a row with SSE and threaded across rows. Light renders through it instead of GL when cpu_lighting is set,
+// and compares it against the shader to catch shader changes that alter the lighting.
+class LightReference
+{
+public:
+	// Width of the shadow map, SHADOW_MAP_ANGLES in shadow_map.fs.glsl
+	static const int SHADOW_ANGLES = 1024;
+
+	// Distance from the headlight to the first occluder by angle, what shadow_map.fs.glsl renders
+	void trace_shadows(const DistanceField& field, vec2 light_position, float range);
+
+	// Light terms of light.fs.glsl built with LIGHT_TERMS into width x height RG8 texels, rows bottom up
+	// as glTexSubImage2D expects them
+	void render_terms(const LightInputs& inputs, const TorchLightmap& lightmap, int width, int height, uint8_t* terms) const;
+
+private:
+	float m_shadow[SHADOW_ANGLES];
+
+	void render_rows(const LightInputs& inputs, const TorchLightmap& lightmap, int width, int height,
+					 int first_row, int end_row, uint8_t* terms) const;
+	float find_light(float angle, float distance) const;
+};
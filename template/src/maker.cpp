@@ -1,6 +1,7 @@
 // Header
 #include "maker.hpp"
 #include "level.hpp"
+#include "gl_debug.hpp"
 
 // stlib
 #include <cassert>
@@ -38,7 +39,7 @@ bool Maker::init(GLFWwindow* window, vec2 screen)
 	// Create a frame buffer
 	m_frame_buffer = 0;
 	glGenFramebuffers(1, &m_frame_buffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, m_frame_buffer);
+	gl_bind_framebuffer(GL_FRAMEBUFFER, m_frame_buffer);
 
 	// For some high DPI displays (ex. Retina Display on Macbooks)
 	// https://stackoverflow.com/questions/36672935/why-retina-screen-coordinate-value-is-twice-the-value-of-pixel-value
@@ -89,7 +90,7 @@ void Maker::draw()
 
 	/////////////////////////////////////
 	// Truely render to screen
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	gl_bind_framebuffer(GL_FRAMEBUFFER, 0);
 
 	// Clearing backbuffer
 	glViewport(0, 0, w, h);
@@ -115,7 +116,7 @@ void Maker::draw()
 
 	vec2 camera_shift = { right / 2.f - camera_pos.x, bottom / 2.f - camera_pos.y };
 
-	m_maker_level.draw_entities(projection_2D, camera_shift);
+	m_maker_level.draw_entities(projection_2D, camera_shift, { right, bottom });
 
 	//////////////////
 	// Presenting
@@ -1,6 +1,5 @@
 #include <iostream>
 #include "maker_level.hpp"
-#include "bitmap_image.hpp"
 
 using json = nlohmann::json;
 
@@ -195,9 +194,9 @@ vec2 MakerLevel::load_level()
 	return m_robot.get_position();
 }
 
-void MakerLevel::draw_entities(const mat3& projection, const vec2& camera_shift) 
+void MakerLevel::draw_entities(const mat3& projection, const vec2& camera_shift, const vec2& view_size) 
 {
-	m_rendering_system.render(projection, camera_shift, { 1.f, 1.f, 1.f });
+	m_rendering_system.render(projection, camera_shift, view_size, { 1.f, 1.f, 1.f });
 }
 
 void MakerLevel::handle_key_press(int key, int action)
@@ -418,32 +417,6 @@ void MakerLevel::process()
 		o << j.dump() << std::endl;
 		o.close();
 	}
-
-	bitmap_image image(40 * 64, 40 * 64);
-	image.set_all_channels(255, 255, 255);
-	rgb_t black = make_colour(0, 0, 0);
-
-	for (auto b : m_bricks)
-	{
-		vec3 colour = b->get_colour();
-		if (colour.x == 0.f || colour.y == 0.f || colour.z == 0.f)
-		{
-			continue;
-		}
-
-		int startx = (int)b->get_position().x;
-		int starty = (int)b->get_position().y;
-		for (int i = 0; i < 64; i++)
-		{
-			for (int j = 0; j < 64; j++)
-			{
-				image.set_pixel(startx + i, starty + j, black);
-			}
-		}
-	}
-
-	image.save_image(maker_shadow);
-	image.clear();
 }
 
 bool MakerLevel::delete_object(vec2 position)
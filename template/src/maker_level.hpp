@@ -22,7 +22,7 @@ class MakerLevel
 public:
 	// Renders level
 	// projection is the 2D orthographic projection matrix
-	void draw_entities(const mat3& projection, const vec2& camera_shift);
+	void draw_entities(const mat3& projection, const vec2& camera_shift, const vec2& view_size);
 
 	// Releases all level-associated resources
 	void destroy();
@@ -0,0 +1,97 @@
+#include "render_queue.hpp"
+#include "gl_debug.hpp"
+
+#include <algorithm>
+
+void RenderState::reset(RenderStats* stats)
+{
+	m_program = UNKNOWN;
+	m_texture = UNKNOWN;
+	m_vao = UNKNOWN;
+	m_blend = UNKNOWN;
+	m_depth_test = UNKNOWN;
+	m_stats = stats;
+}
+
+bool RenderState::changed(GLuint& current, GLuint value)
+{
+	if (current == value)
+	{
+		m_stats->redundant_calls++;
+		return false;
+	}
+
+	current = value;
+	m_stats->state_calls++;
+	return true;
+}
+
+void RenderState::use_program(GLuint program)
+{
+	if (changed(m_program, program))
+		gl_use_program(program);
+}
+
+void RenderState::bind_texture(GLuint texture)
+{
+	if (changed(m_texture, texture))
+	{
+		glActiveTexture(GL_TEXTURE0);
+		gl_bind_texture(GL_TEXTURE_2D, texture);
+	}
+}
+
+void RenderState::bind_vertex_array(GLuint vao)
+{
+	if (changed(m_vao, vao))
+		gl_bind_vertex_array(vao);
+}
+
+void RenderState::set_blend(Blend blend)
+{
+	if (!changed(m_blend, (GLuint)blend))
+		return;
+
+	gl_enable(GL_BLEND);
+	if (blend == Blend::additive)
+		gl_blend_func(GL_SRC_ALPHA, GL_ONE);
+	else
+		gl_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void RenderState::set_depth_test(bool enabled)
+{
+	if (!changed(m_depth_test, (GLuint)enabled))
+		return;
+
+	if (enabled)
+		gl_enable(GL_DEPTH_TEST);
+	else
+		gl_disable(GL_DEPTH_TEST);
+}
+
+void RenderState::count_draw()
+{
+	m_stats->draw_calls++;
+}
+
+void RenderQueue::clear()
+{
+	m_items.clear();
+}
+
+void RenderQueue::push(Layer layer, GLuint program, GLuint texture, Blend blend, int entity)
+{
+	// 8 bits of layer, 24 of program, 24 of texture and 8 of blend, most significant first
+	uint64_t key = ((uint64_t)layer << 56) |
+				   ((uint64_t)(program & 0xffffff) << 32) |
+				   ((uint64_t)(texture & 0xffffff) << 8) |
+				   (uint64_t)blend;
+	m_items.push_back({ key, entity });
+}
+
+void RenderQueue::sort()
+{
+	std::stable_sort(m_items.begin(), m_items.end(),
+		[](const RenderItem& a, const RenderItem& b) { return a.key < b.key; });
+}
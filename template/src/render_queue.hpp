@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "components.hpp"
+
+// Per frame counters of a RenderingSystem
+struct RenderStats
+{
+	int items = 0; // sprites and instanced batches queued
+	int draw_calls = 0;
+	int state_calls = 0; // GL state changes issued
+	int redundant_calls = 0; // GL state changes skipped because the state was already set
+	int unlit_culled = 0; // sprites and brick chunks skipped as no light reaches them
+};
+
+// Shadows the GL state the sprite paths touch so only changes reach the driver.
+// Other passes (light, screen copies) change state behind its back, so it is reset before every submission.
+class RenderState
+{
+public:
+	void reset(RenderStats* stats);
+
+	void use_program(GLuint program);
+	void bind_texture(GLuint texture); // texture unit 0
+	void bind_vertex_array(GLuint vao);
+	void set_blend(Blend blend);
+	void set_depth_test(bool enabled);
+	void count_draw();
+
+private:
+	// True when value differs from current, which is then updated
+	bool changed(GLuint& current, GLuint value);
+
+	static const GLuint UNKNOWN = ~0u;
+
+	GLuint m_program = UNKNOWN;
+	GLuint m_texture = UNKNOWN;
+	GLuint m_vao = UNKNOWN;
+	GLuint m_blend = UNKNOWN;
+	GLuint m_depth_test = UNKNOWN;
+	RenderStats* m_stats = nullptr;
+};
+
+// Entity id standing in for the whole instanced batch in the queue
+const int INSTANCED_BATCH = -1;
+
+struct RenderItem
+{
+	uint64_t key;
+	int entity;
+};
+
+// Draw list sorted by (layer, program, texture, blend) so sprites sharing state are submitted together.
+// The sort is stable, items with equal keys keep the order they were pushed in.
+class RenderQueue
+{
+public:
+	void clear();
+	void push(Layer layer, GLuint program, GLuint texture, Blend blend, int entity);
+	void sort();
+
+	const std::vector<RenderItem>& items() const { return m_items; }
+
+private:
+	std::vector<RenderItem> m_items;
+};
@@ -0,0 +1,190 @@
+#include "shape_batch.hpp"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SHAPE_BATCH_SSE
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Bits of the first count shapes
+	uint32_t first_bits(int count)
+	{
+		return count >= 32 ? 0xffffffffu : (1u << count) - 1u;
+	}
+
+	// Groups of four covering count shapes
+	int groups_of(int count)
+	{
+		return (count + 3) / 4;
+	}
+
+#ifdef SHAPE_BATCH_SSE
+	__m128 clamp_ps(__m128 value, __m128 low, __m128 high)
+	{
+		return _mm_min_ps(_mm_max_ps(value, low), high);
+	}
+#endif
+}
+
+void ShapeBatch::clear()
+{
+	m_circle_count = 0;
+	m_box_count = 0;
+}
+
+bool ShapeBatch::add_circle(vec2 centre, float radius)
+{
+	if (m_circle_count == CAPACITY)
+		return false;
+
+	m_circle_x[m_circle_count] = centre.x;
+	m_circle_y[m_circle_count] = centre.y;
+	m_circle_radius[m_circle_count] = radius;
+	m_circle_count++;
+	return true;
+}
+
+bool ShapeBatch::add_box(vec2 min, vec2 max)
+{
+	if (m_box_count == CAPACITY)
+		return false;
+
+	m_box_min_x[m_box_count] = min.x;
+	m_box_min_y[m_box_count] = min.y;
+	m_box_max_x[m_box_count] = max.x;
+	m_box_max_y[m_box_count] = max.y;
+	m_box_count++;
+	return true;
+}
+
+int ShapeBatch::get_circle_count() const
+{
+	return m_circle_count;
+}
+
+int ShapeBatch::get_box_count() const
+{
+	return m_box_count;
+}
+
+uint32_t ShapeBatch::circles_touching_circle(vec2 centre, float radius, float slack) const
+{
+	uint32_t mask = 0;
+#ifdef SHAPE_BATCH_SSE
+	__m128 x = _mm_set1_ps(centre.x);
+	__m128 y = _mm_set1_ps(centre.y);
+	__m128 reach = _mm_set1_ps(radius + slack);
+	for (int group = 0; group < groups_of(m_circle_count); group++)
+	{
+		int i = group * 4;
+		__m128 dx = _mm_sub_ps(_mm_load_ps(m_circle_x + i), x);
+		__m128 dy = _mm_sub_ps(_mm_load_ps(m_circle_y + i), y);
+		__m128 distance = _mm_add_ps(_mm_load_ps(m_circle_radius + i), reach);
+		__m128 inside = _mm_cmple_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(distance, distance));
+		mask |= (uint32_t)_mm_movemask_ps(inside) << i;
+	}
+#else
+	for (int i = 0; i < m_circle_count; i++)
+	{
+		float dx = m_circle_x[i] - centre.x;
+		float dy = m_circle_y[i] - centre.y;
+		float distance = m_circle_radius[i] + radius + slack;
+		if (dx * dx + dy * dy <= distance * distance)
+			mask |= 1u << i;
+	}
+#endif
+	return mask & first_bits(m_circle_count);
+}
+
+uint32_t ShapeBatch::boxes_touching_circle(vec2 centre, float radius, float slack) const
+{
+	uint32_t mask = 0;
+#ifdef SHAPE_BATCH_SSE
+	__m128 x = _mm_set1_ps(centre.x);
+	__m128 y = _mm_set1_ps(centre.y);
+	__m128 reach = _mm_set1_ps(radius + slack);
+	__m128 reach_squared = _mm_mul_ps(reach, reach);
+	for (int group = 0; group < groups_of(m_box_count); group++)
+	{
+		int i = group * 4;
+		__m128 dx = _mm_sub_ps(x, clamp_ps(x, _mm_load_ps(m_box_min_x + i), _mm_load_ps(m_box_max_x + i)));
+		__m128 dy = _mm_sub_ps(y, clamp_ps(y, _mm_load_ps(m_box_min_y + i), _mm_load_ps(m_box_max_y + i)));
+		__m128 inside = _mm_cmple_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), reach_squared);
+		mask |= (uint32_t)_mm_movemask_ps(inside) << i;
+	}
+#else
+	float reach = radius + slack;
+	for (int i = 0; i < m_box_count; i++)
+	{
+		float dx = centre.x - std::min(std::max(centre.x, m_box_min_x[i]), m_box_max_x[i]);
+		float dy = centre.y - std::min(std::max(centre.y, m_box_min_y[i]), m_box_max_y[i]);
+		if (dx * dx + dy * dy <= reach * reach)
+			mask |= 1u << i;
+	}
+#endif
+	return mask & first_bits(m_box_count);
+}
+
+uint32_t ShapeBatch::circles_touching_box(vec2 min, vec2 max, float slack) const
+{
+	uint32_t mask = 0;
+#ifdef SHAPE_BATCH_SSE
+	__m128 min_x = _mm_set1_ps(min.x);
+	__m128 min_y = _mm_set1_ps(min.y);
+	__m128 max_x = _mm_set1_ps(max.x);
+	__m128 max_y = _mm_set1_ps(max.y);
+	__m128 gap = _mm_set1_ps(slack);
+	for (int group = 0; group < groups_of(m_circle_count); group++)
+	{
+		int i = group * 4;
+		__m128 x = _mm_load_ps(m_circle_x + i);
+		__m128 y = _mm_load_ps(m_circle_y + i);
+		__m128 dx = _mm_sub_ps(x, clamp_ps(x, min_x, max_x));
+		__m128 dy = _mm_sub_ps(y, clamp_ps(y, min_y, max_y));
+		__m128 reach = _mm_add_ps(_mm_load_ps(m_circle_radius + i), gap);
+		__m128 inside = _mm_cmple_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(reach, reach));
+		mask |= (uint32_t)_mm_movemask_ps(inside) << i;
+	}
+#else
+	for (int i = 0; i < m_circle_count; i++)
+	{
+		float dx = m_circle_x[i] - std::min(std::max(m_circle_x[i], min.x), max.x);
+		float dy = m_circle_y[i] - std::min(std::max(m_circle_y[i], min.y), max.y);
+		float reach = m_circle_radius[i] + slack;
+		if (dx * dx + dy * dy <= reach * reach)
+			mask |= 1u << i;
+	}
+#endif
+	return mask & first_bits(m_circle_count);
+}
+
+uint32_t ShapeBatch::boxes_touching_box(vec2 min, vec2 max, float slack) const
+{
+	uint32_t mask = 0;
+#ifdef SHAPE_BATCH_SSE
+	__m128 min_x = _mm_set1_ps(min.x);
+	__m128 min_y = _mm_set1_ps(min.y);
+	__m128 max_x = _mm_set1_ps(max.x);
+	__m128 max_y = _mm_set1_ps(max.y);
+	__m128 gap = _mm_set1_ps(slack);
+	for (int group = 0; group < groups_of(m_box_count); group++)
+	{
+		int i = group * 4;
+		__m128 overlap_x = _mm_and_ps(_mm_cmple_ps(_mm_load_ps(m_box_min_x + i), _mm_add_ps(max_x, gap)),
+									  _mm_cmpge_ps(_mm_add_ps(_mm_load_ps(m_box_max_x + i), gap), min_x));
+		__m128 overlap_y = _mm_and_ps(_mm_cmple_ps(_mm_load_ps(m_box_min_y + i), max_y), _mm_cmpge_ps(_mm_load_ps(m_box_max_y + i), min_y));
+		mask |= (uint32_t)_mm_movemask_ps(_mm_and_ps(overlap_x, overlap_y)) << i;
+	}
+#else
+	for (int i = 0; i < m_box_count; i++)
+	{
+		if (m_box_min_x[i] <= max.x + slack && m_box_max_x[i] + slack >= min.x &&
+			m_box_min_y[i] <= max.y && m_box_max_y[i] >= min.y)
+			mask |= 1u << i;
+	}
+#endif
+	return mask & first_bits(m_box_count);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "common.hpp"
+
+#include <cstdint>
+
+// Circles and axis aligned boxes kept as separate coordinate arrays, so one shape is tested against four of them
+// at once with SSE. Tests compare squared distances and return a mask with bit i set where shape i passes.
+// slack is the gap still counted as touching, Hitbox passes TOLERANCE.
+class ShapeBatch
+{
+public:
+	// Most shapes of each kind, one bit each in a mask
+	static const int CAPACITY = 32;
+
+	// Drops every shape
+	void clear();
+
+	// False when the batch is full
+	bool add_circle(vec2 centre, float radius);
+	bool add_box(vec2 min, vec2 max);
+
+	int get_circle_count() const;
+	int get_box_count() const;
+
+	// Circles within slack of the circle
+	uint32_t circles_touching_circle(vec2 centre, float radius, float slack) const;
+
+	// Boxes within slack of the circle
+	uint32_t boxes_touching_circle(vec2 centre, float radius, float slack) const;
+
+	// Circles within slack of the box
+	uint32_t circles_touching_box(vec2 min, vec2 max, float slack) const;
+
+	// Boxes overlapping the box, edges included. Like Square, slack is only allowed along x.
+	uint32_t boxes_touching_box(vec2 min, vec2 max, float slack) const;
+
+private:
+	int m_circle_count = 0;
+	int m_box_count = 0;
+
+	// Padded to whole groups of four, lanes past the count are masked off
+	alignas(16) float m_circle_x[CAPACITY];
+	alignas(16) float m_circle_y[CAPACITY];
+	alignas(16) float m_circle_radius[CAPACITY];
+	alignas(16) float m_box_min_x[CAPACITY];
+	alignas(16) float m_box_min_y[CAPACITY];
+	alignas(16) float m_box_max_x[CAPACITY];
+	alignas(16) float m_box_max_y[CAPACITY];
+};
@@ -19,6 +19,7 @@ bool Sign::init(int id, std::string sign_text, vec2 position)
 
 	if (!rc.init_sprite())
 		return false;
+	rc.is_static = true;
 
 	mc.position = position;
 	mc.physics.scale = { brick_size / rc.texture->width, brick_size / rc.texture->height };
@@ -33,7 +34,7 @@ bool Sign::init(int id, std::string sign_text, vec2 position)
 	return m_text.init(id + 1, sign_text, position);
 }
 
-Hitbox Sign::get_hitbox() const
+const Hitbox& Sign::get_hitbox() const
 {
     return m_hitbox;
 }
@@ -49,17 +50,13 @@ void Sign::hide_text()
 }
 
 void Sign::calculate_hitbox() {
-    std::vector<Square> squares(2);
-
     float width = brick_size;
     vec2 position = mc.position;
     position.x -= width / 2;
     position.y += width / 2;
     Square top(position, (int)width);
     Square bot(add(position, { 0.f, width }), (int)width);
-    squares[0] = top;
-    squares[1] = bot;
 
-    Hitbox hitbox({}, squares);
+    Hitbox hitbox({}, {top, bot});
     m_hitbox = hitbox;
 }
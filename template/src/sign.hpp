@@ -15,7 +15,7 @@ public:
 	// Creates all the associated render resources and default transform
 	bool init(int id, std::string text, vec2 position);
 
-	Hitbox get_hitbox() const;
+	const Hitbox& get_hitbox() const;
 
 	void show_text();
 
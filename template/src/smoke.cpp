@@ -37,6 +37,7 @@ bool Smoke::init(int id)
 			return false;
 
 		rc_large.render = true;
+		rc_large.layer = Layer::actors;
 	}
 	if (!smoke_texture_small.is_valid())
 	{
@@ -52,6 +53,7 @@ bool Smoke::init(int id)
 			return false;
 
 		rc_small.render = true;
+		rc_small.layer = Layer::actors;
 	}
 
 	float scale = MIN_SCALE + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (MAX_SCALE - MIN_SCALE)));
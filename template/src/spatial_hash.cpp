@@ -0,0 +1,132 @@
+#include "spatial_hash.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+	// Two bricks a side, ghosts, signs and doors cover one or two cells
+	const float CELL_SIZE = brick_size * 2.f;
+
+	// Power of two, cells far apart share buckets and are told apart by their bounds
+	const int BUCKET_COUNT = 1024;
+
+	int cell_of(float position)
+	{
+		return (int)std::floor(position / CELL_SIZE);
+	}
+}
+
+void SpatialHash::clear()
+{
+	m_records.clear();
+	m_buckets.assign(BUCKET_COUNT, std::vector<Handle>());
+	m_result.clear();
+}
+
+SpatialHash::Handle SpatialHash::insert(Kind kind, int index, vec2 min, vec2 max)
+{
+	if (m_buckets.empty())
+		m_buckets.resize(BUCKET_COUNT);
+
+	Record record;
+	record.entry = { kind, index };
+	record.min_x = cell_of(min.x);
+	record.min_y = cell_of(min.y);
+	record.max_x = cell_of(max.x);
+	record.max_y = cell_of(max.y);
+	record.stamp = m_stamp;
+	m_records.push_back(record);
+
+	Handle handle = (Handle)m_records.size() - 1;
+	link(handle);
+	return handle;
+}
+
+void SpatialHash::update(Handle handle, vec2 min, vec2 max)
+{
+	Record& record = m_records[handle];
+	int min_x = cell_of(min.x);
+	int min_y = cell_of(min.y);
+	int max_x = cell_of(max.x);
+	int max_y = cell_of(max.y);
+	if (min_x == record.min_x && min_y == record.min_y && max_x == record.max_x && max_y == record.max_y)
+		return;
+
+	unlink(handle);
+	record.min_x = min_x;
+	record.min_y = min_y;
+	record.max_x = max_x;
+	record.max_y = max_y;
+	link(handle);
+}
+
+const std::vector<SpatialHash::Entry>& SpatialHash::query(vec2 min, vec2 max)
+{
+	m_result.clear();
+	if (m_buckets.empty())
+		return m_result;
+
+	// Stamping entries as they are found returns those covering several of the cells once
+	m_stamp++;
+	int min_x = cell_of(min.x);
+	int min_y = cell_of(min.y);
+	int max_x = cell_of(max.x);
+	int max_y = cell_of(max.y);
+	for (int y = min_y; y <= max_y; y++)
+	{
+		for (int x = min_x; x <= max_x; x++)
+		{
+			for (Handle handle : bucket(x, y))
+			{
+				Record& record = m_records[handle];
+				if (record.stamp == m_stamp || x < record.min_x || x > record.max_x || y < record.min_y || y > record.max_y)
+					continue;
+
+				record.stamp = m_stamp;
+				m_result.push_back(record.entry);
+			}
+		}
+	}
+
+	return m_result;
+}
+
+std::vector<SpatialHash::Handle>& SpatialHash::bucket(int x, int y)
+{
+	uint32_t hash = ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u);
+	return m_buckets[hash & (BUCKET_COUNT - 1)];
+}
+
+void SpatialHash::link(Handle handle)
+{
+	const Record& record = m_records[handle];
+	for (int y = record.min_y; y <= record.max_y; y++)
+	{
+		for (int x = record.min_x; x <= record.max_x; x++)
+		{
+			std::vector<Handle>& cell = bucket(x, y);
+			// Cells of one entry sharing a bucket list it once
+			if (std::find(cell.begin(), cell.end(), handle) == cell.end())
+				cell.push_back(handle);
+		}
+	}
+}
+
+void SpatialHash::unlink(Handle handle)
+{
+	const Record& record = m_records[handle];
+	for (int y = record.min_y; y <= record.max_y; y++)
+	{
+		for (int x = record.min_x; x <= record.max_x; x++)
+		{
+			std::vector<Handle>& cell = bucket(x, y);
+			auto found = std::find(cell.begin(), cell.end(), handle);
+			if (found != cell.end())
+			{
+				*found = cell.back();
+				cell.pop_back();
+			}
+		}
+	}
+}
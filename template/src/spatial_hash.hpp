@@ -0,0 +1,53 @@
+#pragma once
+
+#include "common.hpp"
+
+#include <vector>
+#include <cstdint>
+
+// Broadphase of the level's ghosts, signs and doors. Each entry is bucketed by the cells its bounds overlap, so
+// finding what lies near the robot costs what is around it rather than every entity of the level.
+class SpatialHash
+{
+public:
+	enum class Kind { ghost, sign, door };
+
+	// What an entry stands for, index is into the level's list of that kind
+	struct Entry
+	{
+		Kind kind;
+		int index;
+	};
+
+	// Handles stay valid until clear
+	typedef int Handle;
+
+	// Drops every entry
+	void clear();
+
+	// Adds an entry covering the world space box min, max
+	Handle insert(Kind kind, int index, vec2 min, vec2 max);
+
+	// Moves an entry to the box min, max, nearly free while it stays within the same cells
+	void update(Handle handle, vec2 min, vec2 max);
+
+	// Entries whose cells overlap the box min, max, each once. The result is overwritten by the next query.
+	const std::vector<Entry>& query(vec2 min, vec2 max);
+
+private:
+	struct Record
+	{
+		Entry entry;
+		int min_x, min_y, max_x, max_y; // cells covered
+		uint32_t stamp; // last query that returned it
+	};
+
+	std::vector<Record> m_records;
+	std::vector<std::vector<Handle>> m_buckets;
+	std::vector<Entry> m_result;
+	uint32_t m_stamp = 0;
+
+	std::vector<Handle>& bucket(int x, int y);
+	void link(Handle handle);
+	void unlink(Handle handle);
+};
@@ -0,0 +1,148 @@
+#include "sprite_batch.hpp"
+#include "gl_debug.hpp"
+
+#include <cstddef>
+
+namespace
+{
+	// 4 vertices per quad, indices have to fit in an unsigned short
+	const int MAX_BATCH_SPRITES = 4096;
+}
+
+bool SpriteBatch::init()
+{
+	// Index buffer never changes, every quad is two triangles over its 4 vertices
+	std::vector<uint16_t> indices;
+	indices.reserve(MAX_BATCH_SPRITES * 6);
+	for (int i = 0; i < MAX_BATCH_SPRITES; ++i)
+	{
+		// Counterclockwise as it's the default opengl front winding direction.
+		uint16_t base = (uint16_t)(i * 4);
+		uint16_t quad[] = { 0, 3, 1, 1, 3, 2 };
+		for (uint16_t index : quad)
+			indices.push_back(base + index);
+	}
+
+	// Clearing errors
+	gl_flush_errors();
+
+	glGenVertexArrays(1, &m_vao);
+	gl_bind_vertex_array(m_vao);
+
+	glGenBuffers(1, &m_vbo);
+	gl_bind_buffer(GL_ARRAY_BUFFER, m_vbo);
+
+	glGenBuffers(1, &m_ibo);
+	gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+	gl_buffer_data(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * indices.size(), indices.data(), GL_STATIC_DRAW);
+
+	struct { Attribute attribute; GLint size; size_t offset; } layout[] = {
+		{ Attribute::in_position, 2, offsetof(SpriteVertex, position) },
+		{ Attribute::in_texcoord, 2, offsetof(SpriteVertex, texcoord) },
+		{ Attribute::in_colour, 4, offsetof(SpriteVertex, colour) },
+	};
+	for (auto& a : layout)
+	{
+		GLint loc = (GLint)a.attribute;
+		glEnableVertexAttribArray(loc);
+		glVertexAttribPointer(loc, a.size, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)a.offset);
+	}
+	gl_bind_vertex_array(0);
+
+	m_vertices.reserve(MAX_BATCH_SPRITES * 4);
+
+	return !gl_has_errors();
+}
+
+void SpriteBatch::begin(const mat3& projection, vec3 headlight_channel, RenderState* state)
+{
+	if (m_vao == 0 && !init())
+	{
+		fprintf(stderr, "Failed to create sprite batch buffers\n");
+	}
+
+	m_state = state;
+	m_vertices.clear();
+	m_effect = nullptr;
+	m_texture = 0;
+	m_projection = projection;
+	m_headlight_channel = headlight_channel;
+}
+
+void SpriteBatch::draw(const RenderComponent& rc, vec3 colour, float alpha)
+{
+	if (m_effect == nullptr || m_effect->program != rc.effect.program || m_texture != rc.texture->id ||
+		m_blend != rc.blend || m_vertices.size() >= MAX_BATCH_SPRITES * 4)
+	{
+		flush();
+		m_effect = &rc.effect;
+		m_texture = rc.texture->id;
+		m_blend = rc.blend;
+	}
+
+	// Same corners and texcoords as the shared unit quad, transformed here instead of in the vertex shader
+	const vec2 corners[] = { { -0.5f, +0.5f }, { +0.5f, +0.5f }, { +0.5f, -0.5f }, { -0.5f, -0.5f } };
+	const vec2 texcoords[] = { { 0.f, 1.f }, { 1.f, 1.f }, { 1.f, 0.f }, { 0.f, 0.f } };
+	for (int i = 0; i < 4; ++i)
+	{
+		SpriteVertex vertex;
+		vec3 corner = { corners[i].x * rc.size.x, corners[i].y * rc.size.y, 1.f };
+		vertex.position = to_vec2(mul(rc.transform.out, corner));
+		vertex.texcoord = { rc.texture->uv_offset.x + texcoords[i].x * rc.texture->uv_scale.x,
+							rc.texture->uv_offset.y + texcoords[i].y * rc.texture->uv_scale.y };
+		vertex.colour = colour;
+		vertex.alpha = alpha;
+		m_vertices.push_back(vertex);
+	}
+}
+
+void SpriteBatch::flush()
+{
+	if (m_vertices.empty())
+		return;
+
+	if (m_vao == 0)
+	{
+		m_vertices.clear();
+		return;
+	}
+
+	// Setting shaders
+	m_state->use_program(m_effect->program);
+
+	// Enabling alpha channel for textures
+	m_state->set_blend(m_blend);
+	m_state->set_depth_test(false);
+
+	gl_uniform_matrix_3fv(m_effect->uniform(Uniform::projection), 1, GL_FALSE, (float*)&m_projection);
+	float channel[] = { m_headlight_channel.x, m_headlight_channel.y, m_headlight_channel.z };
+	gl_uniform_3fv(m_effect->uniform(Uniform::headlight_channel), 1, channel);
+
+	// Enabling and binding texture to slot 0
+	m_state->bind_texture(m_texture);
+
+	// Upload the queued quads, orphaning the previous storage
+	m_state->bind_vertex_array(m_vao);
+	gl_bind_buffer(GL_ARRAY_BUFFER, m_vbo);
+	gl_buffer_data(GL_ARRAY_BUFFER, sizeof(SpriteVertex) * m_vertices.size(), m_vertices.data(), GL_STREAM_DRAW);
+
+	// Drawing!
+	gl_draw_elements(GL_TRIANGLES, (GLsizei)(m_vertices.size() / 4 * 6), GL_UNSIGNED_SHORT, nullptr);
+	m_state->count_draw();
+
+	m_vertices.clear();
+}
+
+void SpriteBatch::destroy()
+{
+	if (m_vao != 0)
+	{
+		glDeleteBuffers(1, &m_vbo);
+		glDeleteBuffers(1, &m_ibo);
+		glDeleteVertexArrays(1, &m_vao);
+		m_vao = 0;
+		m_vbo = 0;
+		m_ibo = 0;
+	}
+	m_vertices.clear();
+}
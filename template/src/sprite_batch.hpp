@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+#include "render_queue.hpp"
+
+// Streams sprite quads into one dynamic vertex buffer and draws them together,
+// the batch is flushed whenever the program or texture page changes or the buffer is full
+class SpriteBatch
+{
+public:
+	// GL state changes go through state until the next begin
+	void begin(const mat3& projection, vec3 headlight_channel, RenderState* state);
+	// Queues rc with its current transform, hiding by headlight colour is decided by the variant of its program
+	void draw(const RenderComponent& rc, vec3 colour, float alpha);
+	// Draws everything queued so far
+	void flush();
+	void destroy();
+
+private:
+	bool init();
+
+	GLuint m_vao = 0;
+	GLuint m_vbo = 0;
+	GLuint m_ibo = 0;
+
+	RenderState* m_state = nullptr;
+	const Effect* m_effect = nullptr;
+	GLuint m_texture = 0;
+	Blend m_blend = Blend::alpha;
+	mat3 m_projection;
+	vec3 m_headlight_channel;
+
+	std::vector<SpriteVertex> m_vertices;
+};
@@ -1,17 +1,43 @@
 #include "systems.hpp"
+#include "gl_debug.hpp"
 
-void RenderingSystem::render(const mat3& projection, const vec2& camera_shift, vec3 headlight_channel)
+#include <cstddef>
+#include <cmath>
+
+void RenderingSystem::render(const mat3& projection, const vec2& camera_shift, const vec2& view_size, vec3 headlight_channel,
+							 const LightMask* light_mask)
 {
-	for (auto& entity : level_entities)
+	// Only the cells overlapping the view are visited
+	grid.update();
+	vec2 top_left = mul(camera_shift, -1.f);
+	visible.clear();
+	grid.query(top_left, ::add(top_left, view_size), visible);
+
+	// Ids follow spawn order, which decides draw order inside a layer
+	std::sort(visible.begin(), visible.end());
+
+	queue.clear();
+	int unlit_culled = 0;
+	for (auto& entity : visible)
 	{
 		RenderComponent* rc = s_render_components[entity];
 		MotionComponent* mc = s_motion_components[entity];
 
-		if (!rc->render || len(sub(mul(sub(camera_shift, { 600.f, 400.f }), -1.f), mc->position)) > 30.f * brick_size)
+		if (!rc->render)
 		{
 			continue;
 		}
 
+		if (light_mask != nullptr)
+		{
+			float extent = VisibilityGrid::extent_of(rc, mc);
+			if (!light_mask->is_lit(::add(mc->position, { -extent, -extent }), ::add(mc->position, { extent, extent })))
+			{
+				unlit_culled++;
+				continue;
+			}
+		}
+
 		// Transformation code, see Rendering and Transformation in the template specification for more info
 		// Incrementally updates transformation matrix, thus ORDER IS IMPORTANT
 		rc->transform.begin();
@@ -21,17 +47,255 @@ void RenderingSystem::render(const mat3& projection, const vec2& camera_shift, v
 		rc->transform.scale(mc->physics.scale);
 		rc->transform.end();
 
-		rc->draw_sprite_alpha(projection, rc->alpha, headlight_channel);
+		queue.push(rc->layer, rc->effect.program, rc->texture->id, rc->blend, entity);
+	}
+
+	// Brick chunks overlapping the view, rebaking the ones that changed, are queued as a single item
+	const float chunk_size = CHUNK_TILES * brick_size;
+	vec2 bottom_right = ::add(top_left, view_size);
+	int min_x = (int)std::floor((top_left.x - brick_size) / chunk_size);
+	int max_x = (int)std::floor((bottom_right.x + brick_size) / chunk_size);
+	int min_y = (int)std::floor((top_left.y - brick_size) / chunk_size);
+	int max_y = (int)std::floor((bottom_right.y + brick_size) / chunk_size);
+
+	visible_chunks.clear();
+	for (int x = min_x; x <= max_x; ++x)
+	{
+		for (int y = min_y; y <= max_y; ++y)
+		{
+			auto it = chunks.find(((uint64_t)(uint32_t)x << 32) | (uint32_t)y);
+			if (it == chunks.end())
+				continue;
+
+			BrickChunk& chunk = it->second;
+			if (light_mask != nullptr && !light_mask->is_lit({ x * chunk_size - brick_size / 2.f, y * chunk_size - brick_size / 2.f },
+															 { (x + 1) * chunk_size + brick_size / 2.f, (y + 1) * chunk_size + brick_size / 2.f }))
+			{
+				unlit_culled++;
+				continue;
+			}
+			if (chunk.dirty && !bake_chunk(chunk))
+				continue;
+			if (chunk.rc != nullptr)
+				visible_chunks.push_back(&chunk);
+		}
 	}
 
+	if (!visible_chunks.empty())
+	{
+		const RenderComponent* rc = visible_chunks.front()->rc;
+		queue.push(rc->layer, instanced_effects[0].program, rc->texture->id, rc->blend, INSTANCED_BATCH);
+	}
+
+	submit(s_render_components, projection, camera_shift, headlight_channel);
+	stats.unlit_culled = unlit_culled;
+
 	if (gl_has_errors())
 	{
 		gl_flush_errors();
 	}
 }
 
+void RenderingSystem::submit(std::map<int, RenderComponent*>& components, const mat3& projection,
+							 const vec2& camera_shift, vec3 headlight_channel)
+{
+	queue.sort();
+
+	stats = RenderStats();
+	stats.items = (int)queue.items().size();
+
+	// Vertex arrays created by begin bypass the state shadow, so reset it afterwards
+	batch.begin(projection, headlight_channel, &state);
+	state.reset(&stats);
+
+	for (auto& item : queue.items())
+	{
+		if (item.entity == INSTANCED_BATCH)
+		{
+			batch.flush();
+			render_instanced(projection, camera_shift, headlight_channel);
+			continue;
+		}
+
+		RenderComponent* rc = components[item.entity];
+		batch.draw(*rc, rc->colour, rc->alpha);
+	}
+	batch.flush();
+}
+
+void RenderingSystem::render_instanced(const mat3& projection, const vec2& camera_shift, vec3 headlight_channel)
+{
+	const RenderComponent* shared_rc = visible_chunks.front()->rc;
+
+	// Enabling alpha channel for textures
+	state.set_blend(shared_rc->blend);
+	state.set_depth_test(false);
+
+	// Enabling and binding texture to slot 0
+	const Texture* texture = shared_rc->texture;
+	state.bind_texture(texture->id);
+
+	// Camera shift and scale are shared, the per instance offset is added in the vertex shader
+	Transform transform;
+	transform.begin();
+	transform.translate(camera_shift);
+	transform.scale(visible_chunks.front()->scale);
+	transform.end();
+
+	float channel[] = { headlight_channel.x, headlight_channel.y, headlight_channel.z };
+	float rect[] = { texture->uv_offset.x, texture->uv_offset.y, texture->uv_scale.x, texture->uv_scale.y };
+
+	// One pass per shader variant, uniforms are only set for variants some visible chunk holds
+	for (int v = 0; v < (int)SpriteVariant::count; ++v)
+	{
+		const Effect& effect = instanced_effects[v];
+		bool uniforms_set = false;
+
+		for (BrickChunk* chunk : visible_chunks)
+		{
+			const InstanceRange& range = chunk->ranges[v];
+			if (range.count == 0)
+				continue;
+
+			if (!uniforms_set)
+			{
+				// Setting shaders
+				state.use_program(effect.program);
+
+				gl_uniform_matrix_3fv(effect.uniform(Uniform::transform), 1, GL_FALSE, (float*)&transform.out);
+				gl_uniform_matrix_3fv(effect.uniform(Uniform::projection), 1, GL_FALSE, (float*)&projection);
+				gl_uniform_2fv(effect.uniform(Uniform::sprite_size), 1, (float*)&shared_rc->size);
+				gl_uniform_3fv(effect.uniform(Uniform::headlight_channel), 1, channel);
+				gl_uniform_4fv(effect.uniform(Uniform::texture_rect), 1, rect);
+				uniforms_set = true;
+			}
+
+			// Drawing!
+			state.bind_vertex_array(range.vao);
+			gl_draw_elements_instanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, nullptr, (GLsizei)range.count);
+			state.count_draw();
+		}
+	}
+}
+
+uint64_t RenderingSystem::chunk_of(vec2 position) const
+{
+	const float chunk_size = CHUNK_TILES * brick_size;
+	int32_t x = (int32_t)std::floor(position.x / chunk_size);
+	int32_t y = (int32_t)std::floor(position.y / chunk_size);
+	return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
+}
+
+bool RenderingSystem::bake_chunk(BrickChunk& chunk)
+{
+	for (int v = 0; v < (int)SpriteVariant::count; ++v)
+	{
+		if (instanced_effects[v].program == 0 &&
+			!instanced_effects[v].load_from_file(shader_path("instanced.vs.glsl"), shader_path("sprite.fs.glsl"),
+												 sprite_variant_defines((SpriteVariant)v)))
+		{
+			return false;
+		}
+	}
+
+	// World space positions and colours, split by the variant that draws them
+	std::vector<SpriteInstance> instances[(int)SpriteVariant::count];
+	chunk.rc = nullptr;
+	for (int entity : chunk.entities)
+	{
+		RenderComponent* rc = s_render_components[entity];
+		MotionComponent* mc = s_motion_components[entity];
+
+		// Invisible bricks never show, they only collide
+		if (!rc->render)
+		{
+			continue;
+		}
+
+		if (chunk.rc == nullptr)
+		{
+			chunk.rc = rc;
+			chunk.scale = mc->physics.scale;
+		}
+
+		SpriteInstance instance;
+		instance.position = mc->position;
+		instance.colour = rc->colour;
+		instance.alpha = rc->alpha;
+		instances[(int)rc->variant].push_back(instance);
+	}
+
+	chunk.dirty = false;
+
+	gl_flush_errors();
+
+	for (int v = 0; v < (int)SpriteVariant::count; ++v)
+	{
+		InstanceRange& range = chunk.ranges[v];
+		range.count = (int)instances[v].size();
+		if (range.count == 0)
+			continue;
+
+		if (range.vao == 0)
+		{
+			glGenVertexArrays(1, &range.vao);
+			glGenBuffers(1, &range.vbo);
+			gl_bind_vertex_array(range.vao);
+
+			// Quad shared by every instance
+			gl_bind_buffer(GL_ARRAY_BUFFER, chunk.rc->mesh.vbo);
+			gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, chunk.rc->mesh.ibo);
+			GLint in_position_loc = (GLint)Attribute::in_position;
+			GLint in_texcoord_loc = (GLint)Attribute::in_texcoord;
+			glEnableVertexAttribArray(in_position_loc);
+			glEnableVertexAttribArray(in_texcoord_loc);
+			glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)0);
+			glVertexAttribPointer(in_texcoord_loc, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)sizeof(vec3));
+
+			// Per instance attributes advance once per quad
+			gl_bind_buffer(GL_ARRAY_BUFFER, range.vbo);
+			struct { Attribute attribute; GLint size; size_t offset; } per_instance[] = {
+				{ Attribute::in_offset, 2, offsetof(SpriteInstance, position) },
+				{ Attribute::in_colour, 4, offsetof(SpriteInstance, colour) },
+			};
+			for (auto& a : per_instance)
+			{
+				GLint loc = (GLint)a.attribute;
+				glEnableVertexAttribArray(loc);
+				glVertexAttribPointer(loc, a.size, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), (void*)a.offset);
+				glVertexAttribDivisor(loc, 1);
+			}
+			gl_bind_vertex_array(0);
+		}
+
+		gl_bind_buffer(GL_ARRAY_BUFFER, range.vbo);
+		gl_buffer_data(GL_ARRAY_BUFFER, sizeof(SpriteInstance) * instances[v].size(), instances[v].data(), GL_STATIC_DRAW);
+	}
+
+	return !gl_has_errors();
+}
+
+void RenderingSystem::clear_chunks()
+{
+	for (auto& it : chunks)
+	{
+		for (InstanceRange& range : it.second.ranges)
+		{
+			if (range.vao != 0)
+			{
+				glDeleteBuffers(1, &range.vbo);
+				glDeleteVertexArrays(1, &range.vao);
+			}
+		}
+	}
+	chunks.clear();
+	entity_chunks.clear();
+	visible_chunks.clear();
+}
+
 void RenderingSystem::render_ui(const mat3& projection, const vec2& camera_shift)
 {
+    queue.clear();
     for (auto& entity : menu_entities)
     {
         RenderComponent* rc = s_ui_render_components[entity];
@@ -50,25 +314,17 @@ void RenderingSystem::render_ui(const mat3& projection, const vec2& camera_shift
         rc->transform.scale(mc->physics.scale);
         rc->transform.end();
 
-        rc->draw_ui_sprite_alpha(projection, rc->alpha);
+        queue.push(rc->layer, rc->effect.program, rc->texture->id, rc->blend, entity);
     }
+
+    submit(s_ui_render_components, projection, camera_shift, { 1.f, 1.f, 1.f });
 }
 
 void RenderingSystem::process(int min, int max)
 {
 	for (int i = min; i < max; i++)
 	{
-		if (s_render_components.find(i) != s_render_components.end() &&
-			s_motion_components.find(i) != s_motion_components.end())
-		{
-			level_entities.push_back(i);
-		}
-
-		if (s_ui_render_components.find(i) != s_ui_render_components.end() &&
-			s_ui_motion_components.find(i) != s_ui_motion_components.end())
-		{
-			menu_entities.push_back(i);
-		}
+		add(i);
 	}
 }
 
@@ -77,7 +333,19 @@ void RenderingSystem::add(int id)
 	if (s_render_components.find(id) != s_render_components.end() &&
 		s_motion_components.find(id) != s_motion_components.end())
 	{
-		level_entities.push_back(id);
+		if (s_render_components[id]->instanced)
+		{
+			uint64_t key = chunk_of(s_motion_components[id]->position);
+			BrickChunk& chunk = chunks[key];
+			chunk.entities.push_back(id);
+			chunk.dirty = true;
+			entity_chunks[id] = key;
+		}
+		else
+		{
+			level_entities.push_back(id);
+			grid.insert(id, s_render_components[id], s_motion_components[id]);
+		}
 	}
 
 	if (s_ui_render_components.find(id) != s_ui_render_components.end() &&
@@ -89,6 +357,17 @@ void RenderingSystem::add(int id)
 
 void RenderingSystem::remove(int id, bool clean)
 {
+	grid.remove(id);
+
+	auto chunk_it = entity_chunks.find(id);
+	if (chunk_it != entity_chunks.end())
+	{
+		// Instanced components are shared, never release them with the entity
+		BrickChunk& chunk = chunks[chunk_it->second];
+		chunk.entities.erase(std::find(chunk.entities.begin(), chunk.entities.end(), id));
+		chunk.dirty = true;
+		entity_chunks.erase(chunk_it);
+	}
 	auto it = std::find(level_entities.begin(), level_entities.end(), id);
 	if (it != level_entities.end())
 	{
@@ -96,13 +375,7 @@ void RenderingSystem::remove(int id, bool clean)
 		{
 			RenderComponent* rc = s_render_components[id];
 
-			glDeleteBuffers(1, &rc->mesh.vbo);
-			glDeleteBuffers(1, &rc->mesh.ibo);
-			glDeleteVertexArrays(1, &rc->mesh.vao);
-
-			glDeleteShader(rc->effect.vertex);
-			glDeleteShader(rc->effect.fragment);
-			glDeleteShader(rc->effect.program);
+			rc->release();
 		}
 
 		level_entities.erase(it);
@@ -114,13 +387,7 @@ void RenderingSystem::remove(int id, bool clean)
 		{
 			RenderComponent* rc = s_ui_render_components[id];
 
-			glDeleteBuffers(1, &rc->mesh.vbo);
-			glDeleteBuffers(1, &rc->mesh.ibo);
-			glDeleteVertexArrays(1, &rc->mesh.vao);
-
-			glDeleteShader(rc->effect.vertex);
-			glDeleteShader(rc->effect.fragment);
-			glDeleteShader(rc->effect.program);
+			rc->release();
 		}
 
 		menu_entities.erase(it);
@@ -133,31 +400,27 @@ void RenderingSystem::destroy()
 	{
 		RenderComponent* rc = s_render_components[entity];
 
-		glDeleteBuffers(1, &rc->mesh.vbo);
-		glDeleteBuffers(1, &rc->mesh.ibo);
-		glDeleteVertexArrays(1, &rc->mesh.vao);
-
-		glDeleteShader(rc->effect.vertex);
-		glDeleteShader(rc->effect.fragment);
-		glDeleteShader(rc->effect.program);
+		rc->release();
 	}
 
 	for (auto& entity : menu_entities)
 	{
 		RenderComponent* rc = s_ui_render_components[entity];
 
-		glDeleteBuffers(1, &rc->mesh.vbo);
-		glDeleteBuffers(1, &rc->mesh.ibo);
-		glDeleteVertexArrays(1, &rc->mesh.vao);
-
-		glDeleteShader(rc->effect.vertex);
-		glDeleteShader(rc->effect.fragment);
-		glDeleteShader(rc->effect.program);
+		rc->release();
 	}
+
+	clear_chunks();
+	for (Effect& effect : instanced_effects)
+		effect.release();
+
+	batch.destroy();
 }
 
 void RenderingSystem::clear()
 {
 	level_entities.clear();
 	menu_entities.clear();
+	clear_chunks();
+	grid.clear();
 }
\ No newline at end of file
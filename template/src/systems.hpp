@@ -2,7 +2,12 @@
 
 #include <vector>
 #include <algorithm>
+#include <unordered_map>
+#include <cstdint>
 #include "components.hpp"
+#include "sprite_batch.hpp"
+#include "visibility_grid.hpp"
+#include "light_mask.hpp"
 
 class RenderingSystem
 {
@@ -10,12 +15,60 @@ private:
 	std::vector<int> level_entities;
 	std::vector<int> menu_entities;
 
+	// Level entities bucketed for culling, visible ones are gathered each frame
+	VisibilityGrid grid;
+	std::vector<int> visible;
+
+	// Every other sprite is streamed through the batch
+	SpriteBatch batch;
+
+	// Visible sprites of the current frame, submitted in key order
+	RenderQueue queue;
+	RenderState state;
+	RenderStats stats;
+
+	// Instanced entities never move, they are baked into chunks of CHUNK_TILES x CHUNK_TILES bricks
+	// whose instance buffers are only rebuilt when a brick is added or removed
+	struct InstanceRange
+	{
+		GLuint vao = 0;
+		GLuint vbo = 0;
+		int count = 0; // instances in vbo
+	};
+	struct BrickChunk
+	{
+		InstanceRange ranges[(int)SpriteVariant::count]; // bricks of each shader variant
+		bool dirty = true;
+		const RenderComponent* rc = nullptr; // any drawn brick of the chunk, they share texture, size and blend
+		vec2 scale;
+		std::vector<int> entities;
+	};
+	static const int CHUNK_TILES = 16;
+
+	Effect instanced_effects[(int)SpriteVariant::count];
+	std::unordered_map<uint64_t, BrickChunk> chunks;
+	std::unordered_map<int, uint64_t> entity_chunks;
+	std::vector<BrickChunk*> visible_chunks;
+
+	uint64_t chunk_of(vec2 position) const;
+	bool bake_chunk(BrickChunk& chunk);
+	void clear_chunks();
+	void render_instanced(const mat3& projection, const vec2& camera_shift, vec3 headlight_channel);
+	void submit(std::map<int, RenderComponent*>& components, const mat3& projection,
+				const vec2& camera_shift, vec3 headlight_channel);
+
 public:
     void render_ui(const mat3& projection, const vec2& camera_shift);
-    void render(const mat3& projection, const vec2& camera_shift, vec3 headlight_channel);
+    // Only what lies in the view_size area the camera shows is drawn. Sprites outside the bricks light_mask marks
+    // lit are not drawn either, the light pass would black them out
+    void render(const mat3& projection, const vec2& camera_shift, const vec2& view_size, vec3 headlight_channel,
+                const LightMask* light_mask = nullptr);
 	void process(int min, int max);
 	void add(int id);
 	void remove(int id, bool clean);
 	void destroy();
 	void clear();
+
+	// Counters of the last render or render_ui call
+	const RenderStats& get_stats() const { return stats; }
 };
@@ -46,6 +46,7 @@ bool Text::init(int id, std::string sign_text, vec2 position)
 
 	if (!rc.init_sprite())
 		return false;
+	rc.is_static = true;
 
 	mc.position = position;
 	mc.position.y -= 130.f;
@@ -0,0 +1,347 @@
+#include "tile_grid.hpp"
+#include "brick.hpp"
+#include "shape_batch.hpp"
+
+#include <cmath>
+#include <cassert>
+#include <limits>
+#include <algorithm>
+
+namespace
+{
+	// Gap left between a moved circle and the brick it stopped at, so it starts the next move outside it
+	const float SKIN = 0.05f;
+
+	// Most bricks a circle is pushed out of before moving
+	const int MAX_PUSHES = 4;
+
+	// Whether a circle centred at offset from a brick's centre overlaps it, and the way out of it
+	bool overlaps_brick(vec2 offset, float radius, vec2& normal, float& depth)
+	{
+		const float half = brick_size / 2.f;
+		vec2 closest = { std::max(-half, std::min(offset.x, half)), std::max(-half, std::min(offset.y, half)) };
+		vec2 out = sub(offset, closest);
+		float distance = len(out);
+		if (distance >= radius)
+			return false;
+
+		if (distance > 0.f)
+		{
+			normal = mul(out, 1.f / distance);
+			depth = radius - distance;
+			return true;
+		}
+
+		// Centre inside the brick, out through the nearest side
+		float inside_x = half - std::abs(offset.x);
+		float inside_y = half - std::abs(offset.y);
+		if (inside_x < inside_y)
+		{
+			normal = { offset.x < 0.f ? -1.f : 1.f, 0.f };
+			depth = inside_x + radius;
+		}
+		else
+		{
+			normal = { 0.f, offset.y < 0.f ? -1.f : 1.f };
+			depth = inside_y + radius;
+		}
+		return true;
+	}
+
+	// Time in [0, 1] at which a circle moving from offset (relative to a brick's centre) by motion touches the
+	// brick. Its centre is traced against the brick grown by radius, with corners rounded by radius.
+	bool sweep_brick(vec2 offset, float radius, vec2 motion, float& time, vec2& normal)
+	{
+		vec2 out;
+		float depth;
+		if (overlaps_brick(offset, radius, out, depth))
+		{
+			// Already touching, only moving further in is stopped
+			if (dot(motion, out) >= 0.f)
+				return false;
+			time = 0.f;
+			normal = out;
+			return true;
+		}
+
+		const float half = brick_size / 2.f;
+		const float grown = half + radius;
+		float start[] = { offset.x, offset.y };
+		float direction[] = { motion.x, motion.y };
+		float enter = -std::numeric_limits<float>::infinity();
+		float leave = 1.f;
+		int axis = -1;
+		for (int i = 0; i < 2; i++)
+		{
+			if (direction[i] == 0.f)
+			{
+				if (std::abs(start[i]) > grown)
+					return false;
+				continue;
+			}
+
+			float near = (-grown - start[i]) / direction[i];
+			float far = (grown - start[i]) / direction[i];
+			if (near > far)
+				std::swap(near, far);
+			if (near > enter)
+			{
+				enter = near;
+				axis = i;
+			}
+			leave = std::min(leave, far);
+			if (enter > leave)
+				return false;
+		}
+		if (enter > 1.f || leave < 0.f)
+			return false;
+
+		// Starting inside the grown brick without touching the brick means starting by one of its corners
+		vec2 contact = add(offset, mul(motion, std::max(enter, 0.f)));
+		if (enter >= 0.f && (std::abs(contact.x) <= half || std::abs(contact.y) <= half))
+		{
+			// A side of the grown brick
+			time = enter;
+			normal = { 0.f, 0.f };
+			if (axis == 0)
+				normal.x = contact.x < 0.f ? -1.f : 1.f;
+			else
+				normal.y = contact.y < 0.f ? -1.f : 1.f;
+			return true;
+		}
+
+		// A rounded corner, the circle of radius around the brick's corner
+		vec2 corner = { contact.x < 0.f ? -half : half, contact.y < 0.f ? -half : half };
+		vec2 from_corner = sub(offset, corner);
+		float a = dot(motion, motion);
+		float b = dot(from_corner, motion);
+		float c = dot(from_corner, from_corner) - radius * radius;
+		float discriminant = b * b - a * c;
+		if (a == 0.f || discriminant < 0.f)
+			return false;
+
+		float t = (-b - std::sqrt(discriminant)) / a;
+		if (t < 0.f || t > 1.f)
+			return false;
+
+		time = t;
+		normal = mul(sub(add(offset, mul(motion, t)), corner), 1.f / radius);
+		return true;
+	}
+}
+
+void TileGrid::init(int width, int height)
+{
+	m_width = width;
+	m_height = height;
+	m_row_words = (width + 63) / 64;
+	m_cells.assign(width * height, nullptr);
+	for (auto& plane : m_planes)
+		plane.assign(m_row_words * height, 0);
+	m_bricks.clear();
+}
+
+bool TileGrid::insert(Brick* brick)
+{
+	m_bricks.push_back(brick);
+
+	vec2 position = brick->get_position();
+	int x = cell_of(position.x);
+	int y = cell_of(position.y);
+	if (!contains(x, y) || m_cells[y * m_width + x] != nullptr)
+		return false;
+
+	m_cells[y * m_width + x] = brick;
+	m_planes[colour_of(brick->get_colour())][y * m_row_words + x / 64] |= (uint64_t)1 << (x % 64);
+	return true;
+}
+
+Brick* TileGrid::at(int x, int y) const
+{
+	if (!contains(x, y))
+		return nullptr;
+	return m_cells[y * m_width + x];
+}
+
+bool TileGrid::is_set(Colour colour, int x, int y) const
+{
+	if (!contains(x, y))
+		return false;
+	return (m_planes[colour][y * m_row_words + x / 64] >> (x % 64)) & 1;
+}
+
+bool TileGrid::is_solid(int x, int y, vec3 headlight_channel) const
+{
+	if (!contains(x, y))
+		return false;
+
+	int word = y * m_row_words + x / 64;
+	uint64_t solid = m_planes[white][word] | m_planes[black][word];
+	Colour headlight = colour_of(headlight_channel);
+	if (headlight != white && headlight != black)
+		solid |= m_planes[headlight][word];
+	return (solid >> (x % 64)) & 1;
+}
+
+bool TileGrid::sweep_circle(vec2 centre, float radius, vec2 motion, vec3 headlight_channel, SweepHit& hit) const
+{
+	hit = SweepHit();
+	bool found = false;
+
+	// Amanatides and Woo walk over the cells the centre crosses. radius is under a brick, so any brick the circle
+	// touches is one of the 3x3 around the centre's cell at that time, the next ring is a brick away. Once the next cell is entered after
+	// the earliest hit so far, no later brick can be hit earlier.
+	const float infinity = std::numeric_limits<float>::infinity();
+	float cell_x = centre.x / brick_size + 0.5f;
+	float cell_y = centre.y / brick_size + 0.5f;
+	int x = (int)std::floor(cell_x);
+	int y = (int)std::floor(cell_y);
+	int step_x = motion.x > 0.f ? 1 : -1;
+	int step_y = motion.y > 0.f ? 1 : -1;
+	float delta_x = motion.x != 0.f ? std::abs(brick_size / motion.x) : infinity;
+	float delta_y = motion.y != 0.f ? std::abs(brick_size / motion.y) : infinity;
+	float next_x = motion.x != 0.f ? (motion.x > 0.f ? x + 1 - cell_x : cell_x - x) * delta_x : infinity;
+	float next_y = motion.y != 0.f ? (motion.y > 0.f ? y + 1 - cell_y : cell_y - y) * delta_y : infinity;
+
+	float entered = 0.f;
+	while (entered <= std::min(hit.time, 1.f))
+	{
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			for (int dx = -1; dx <= 1; dx++)
+			{
+				if (!is_solid(x + dx, y + dy, headlight_channel))
+					continue;
+
+				vec2 brick = { (x + dx) * brick_size, (y + dy) * brick_size };
+				float time;
+				vec2 normal;
+				if (sweep_brick(sub(centre, brick), radius, motion, time, normal) && (!found || time < hit.time))
+				{
+					hit.time = time;
+					hit.normal = normal;
+					hit.cell_x = x + dx;
+					hit.cell_y = y + dy;
+					found = true;
+				}
+			}
+		}
+
+		if (next_x < next_y)
+		{
+			entered = next_x;
+			next_x += delta_x;
+			x += step_x;
+		}
+		else
+		{
+			entered = next_y;
+			next_y += delta_y;
+			y += step_y;
+		}
+	}
+
+	return found;
+}
+
+TileGrid::SlideResult TileGrid::move_circle(vec2 centre, float radius, vec2 motion, vec3 headlight_channel) const
+{
+	assert(radius < brick_size);
+	SlideResult result;
+	result.position = push_out(centre, radius, headlight_channel);
+
+	vec2 remaining = motion;
+	for (int i = 0; i < MAX_SLIDES; i++)
+	{
+		SweepHit hit;
+		if (!sweep_circle(result.position, radius, remaining, headlight_channel, hit))
+		{
+			result.position = add(result.position, remaining);
+			break;
+		}
+		result.contacts[result.contact_count++] = hit;
+
+		// Stop just off the brick, what is left of the motion continues along it
+		result.position = add(add(result.position, mul(remaining, hit.time)), mul(hit.normal, SKIN));
+		remaining = mul(remaining, 1.f - hit.time);
+		float into = dot(remaining, hit.normal);
+		if (into < 0.f)
+			remaining = sub(remaining, mul(hit.normal, into));
+	}
+
+	return result;
+}
+
+vec2 TileGrid::push_out(vec2 centre, float radius, vec3 headlight_channel) const
+{
+	// Bricks turn solid under the inside of a circle when the headlight changes colour
+	for (int i = 0; i < MAX_PUSHES; i++)
+	{
+		int x = cell_of(centre.x);
+		int y = cell_of(centre.y);
+		const float half = brick_size / 2.f;
+		ShapeBatch neighbours;
+		vec2 bricks[9];
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			for (int dx = -1; dx <= 1; dx++)
+			{
+				if (!is_solid(x + dx, y + dy, headlight_channel))
+					continue;
+
+				vec2 brick = { (x + dx) * brick_size, (y + dy) * brick_size };
+				bricks[neighbours.get_box_count()] = brick;
+				neighbours.add_box({ brick.x - half, brick.y - half }, { brick.x + half, brick.y + half });
+			}
+		}
+
+		// The solid neighbours are tested at once, only those the circle reaches are resolved
+		vec2 deepest_normal = { 0.f, 0.f };
+		float deepest = 0.f;
+		uint32_t reached = neighbours.boxes_touching_circle(centre, radius, 0.f);
+		for (int b = 0; reached != 0; b++, reached >>= 1)
+		{
+			vec2 normal;
+			float depth;
+			if ((reached & 1u) != 0 && overlaps_brick(sub(centre, bricks[b]), radius, normal, depth) && depth > deepest)
+			{
+				deepest = depth;
+				deepest_normal = normal;
+			}
+		}
+
+		if (deepest == 0.f)
+			break;
+		centre = add(centre, mul(deepest_normal, deepest + SKIN));
+	}
+
+	return centre;
+}
+
+const std::vector<Brick*>& TileGrid::get_bricks() const
+{
+	return m_bricks;
+}
+
+int TileGrid::cell_of(float position)
+{
+	return (int)std::floor(position / brick_size + 0.5f);
+}
+
+TileGrid::Colour TileGrid::colour_of(vec3 colour)
+{
+	if (colour.x == 1.f && colour.y == 1.f && colour.z == 1.f)
+		return white;
+	if (colour.x == 1.f && colour.y == 0.f && colour.z == 0.f)
+		return red;
+	if (colour.x == 0.f && colour.y == 1.f && colour.z == 0.f)
+		return green;
+	if (colour.x == 0.f && colour.y == 0.f && colour.z == 1.f)
+		return blue;
+	return black;
+}
+
+bool TileGrid::contains(int x, int y) const
+{
+	return x >= 0 && x < m_width && y >= 0 && y < m_height;
+}
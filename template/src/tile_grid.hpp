@@ -0,0 +1,81 @@
+#pragma once
+
+#include "common.hpp"
+
+#include <vector>
+#include <cstdint>
+
+class Brick;
+
+// Bricks of the level by integer cell. Each cell holds its brick and a bit in the occupancy plane of the
+// brick's colour, so lookups index arrays instead of hashing positions and never allocate.
+class TileGrid
+{
+public:
+	enum Colour { white, red, green, blue, black, colour_count };
+
+	// First brick touched by a moving circle
+	struct SweepHit
+	{
+		float time = 1.f; // fraction of the motion travelled before touching
+		vec2 normal = { 0.f, 0.f }; // out of the brick, towards the circle
+		int cell_x = -1;
+		int cell_y = -1;
+	};
+
+	// Most bricks move_circle slides along in one move
+	static const int MAX_SLIDES = 4;
+
+	// Where move_circle left a circle and the bricks it hit on the way, in order
+	struct SlideResult
+	{
+		vec2 position;
+		int contact_count = 0;
+		SweepHit contacts[MAX_SLIDES];
+	};
+
+	// width and height in bricks, drops every brick
+	void init(int width, int height);
+
+	// Adds brick in the cell of its pixel position. False if that lies outside the grid or the cell is taken,
+	// the brick is then listed in get_bricks but never found by cell.
+	bool insert(Brick* brick);
+
+	// The brick in cell x, y, nullptr when empty or outside the grid
+	Brick* at(int x, int y) const;
+
+	// Whether a brick of colour occupies cell x, y
+	bool is_set(Colour colour, int x, int y) const;
+
+	// Whether the brick in cell x, y blocks the robot with the headlight set to headlight_channel. White and
+	// black bricks always do, coloured ones only under their own colour, as Brick::update decides.
+	bool is_solid(int x, int y, vec3 headlight_channel) const;
+
+	// Sweeps a circle of radius from centre by motion through the bricks solid under headlight_channel, walking
+	// the cells its centre crosses. False if it moves the whole way without touching one.
+	bool sweep_circle(vec2 centre, float radius, vec2 motion, vec3 headlight_channel, SweepHit& hit) const;
+
+	// Moves a circle by motion, stopping where it hits a solid brick and sliding along it with the rest of the
+	// motion. A circle starting inside bricks is pushed out of them first. radius must be under a brick.
+	SlideResult move_circle(vec2 centre, float radius, vec2 motion, vec3 headlight_channel) const;
+
+	// Every brick, in insertion order
+	const std::vector<Brick*>& get_bricks() const;
+
+	// Cell holding the pixel position, bricks are centred on their cell's pixel position
+	static int cell_of(float position);
+
+	// Colours other than white, red, green and blue count as black
+	static Colour colour_of(vec3 colour);
+
+private:
+	int m_width = 0;
+	int m_height = 0;
+	int m_row_words = 0; // words per row of a plane
+	std::vector<Brick*> m_cells; // row major
+	std::vector<uint64_t> m_planes[colour_count];
+	std::vector<Brick*> m_bricks;
+
+	bool contains(int x, int y) const;
+	vec2 push_out(vec2 centre, float radius, vec3 headlight_channel) const;
+};
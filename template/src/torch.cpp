@@ -19,6 +19,8 @@ bool Torch::init(int id)
 
         if (!rc.init_sprite())
             return false;
+
+        rc.is_static = true;
     }
 
     mc.position = { 0.f, 0.f };
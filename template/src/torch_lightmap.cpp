@@ -0,0 +1,166 @@
+#include "torch_lightmap.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+const float TorchLightmap::TEXEL_SIZE = brick_size / TorchLightmap::TEXELS_PER_BRICK;
+const float TorchLightmap::RANGE = 384.f;
+
+namespace
+{
+	// Bumped whenever the baked light changes for the same level, stale caches then fail to load
+	const uint32_t BAKE_VERSION = 1;
+	const uint32_t FILE_MAGIC = 0x4d4c5454; // "TTLM"
+
+	// Same trace and falloff as the shadow map lookup in light.fs.glsl
+	const int MAX_TRACE_STEPS = 128;
+	const float MIN_TRACE_STEP = 2.f;
+	const float BLOCKING_DEPTH = 64.f;
+
+	// Fraction of the light from source that reaches the point at distance along direction d
+	float trace(const DistanceField& field, vec2 source, vec2 d, float distance)
+	{
+		// Positions in the field are relative to the top left corner of the level
+		float offset = brick_size / 2.f;
+
+		float t = 0.f;
+		for (int i = 0; i < MAX_TRACE_STEPS && t < distance; i++)
+		{
+			float clearance = field.sample(source.x + t * d.x + offset, source.y + t * d.y + offset);
+			if (clearance <= 0.f)
+				break;
+
+			t += std::max(clearance, MIN_TRACE_STEP);
+		}
+
+		return 1.f - std::max(0.f, std::min((distance - t) / BLOCKING_DEPTH, 1.f));
+	}
+}
+
+uint64_t TorchLightmap::content_hash(const std::string& level_source)
+{
+	// 64 bit FNV-1a over the source, then the parameters the bake depends on
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](const void* bytes, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= ((const uint8_t*)bytes)[i];
+			hash *= 1099511628211ull;
+		}
+	};
+
+	mix(level_source.data(), level_source.size());
+	mix(&BAKE_VERSION, sizeof(BAKE_VERSION));
+	int32_t texels_per_brick = TEXELS_PER_BRICK;
+	mix(&texels_per_brick, sizeof(texels_per_brick));
+	mix(&RANGE, sizeof(RANGE));
+	return hash;
+}
+
+void TorchLightmap::bake(const DistanceField& field, const std::vector<vec2>& torches, int width, int height)
+{
+	m_width = width * TEXELS_PER_BRICK;
+	m_height = height * TEXELS_PER_BRICK;
+
+	// Torches do not add up, each texel keeps the brightest one as the shader did per pixel
+	std::vector<float> light(m_width * m_height, 0.f);
+	float offset = brick_size / 2.f;
+
+	for (vec2 torch : torches)
+	{
+		// Only texels within range of the torch
+		int x0 = std::max((int)std::floor((torch.x - RANGE + offset) / TEXEL_SIZE), 0);
+		int y0 = std::max((int)std::floor((torch.y - RANGE + offset) / TEXEL_SIZE), 0);
+		int x1 = std::min((int)std::floor((torch.x + RANGE + offset) / TEXEL_SIZE), m_width - 1);
+		int y1 = std::min((int)std::floor((torch.y + RANGE + offset) / TEXEL_SIZE), m_height - 1);
+
+		for (int y = y0; y <= y1; y++)
+		{
+			for (int x = x0; x <= x1; x++)
+			{
+				vec2 p = { (x + 0.5f) * TEXEL_SIZE - offset, (y + 0.5f) * TEXEL_SIZE - offset };
+				vec2 d = sub(p, torch);
+				float distance = len(d);
+				if (distance >= RANGE)
+					continue;
+
+				float reached = distance < 1.f ? 1.f : trace(field, torch, mul(d, 1.f / distance), distance);
+				float& texel = light[y * m_width + x];
+				texel = std::max(texel, std::sqrt(1.f - distance / RANGE) * reached);
+			}
+		}
+	}
+
+	m_light.resize(m_width * m_height);
+	for (int i = 0; i < m_width * m_height; i++)
+		m_light[i] = (uint8_t)(std::min(light[i], 1.f) * 255.f + 0.5f);
+}
+
+float TorchLightmap::sample(float x, float y) const
+{
+	if (m_light.empty())
+		return 0.f;
+
+	// Texel centres sit half a texel in, positions past the edges clamp to them
+	float u = std::max(0.f, std::min(x / TEXEL_SIZE - 0.5f, m_width - 1.f));
+	float v = std::max(0.f, std::min(y / TEXEL_SIZE - 0.5f, m_height - 1.f));
+	int x0 = (int)u;
+	int y0 = (int)v;
+	int x1 = std::min(x0 + 1, m_width - 1);
+	int y1 = std::min(y0 + 1, m_height - 1);
+	float fx = u - x0;
+	float fy = v - y0;
+
+	float top = m_light[y0 * m_width + x0] * (1 - fx) + m_light[y0 * m_width + x1] * fx;
+	float bottom = m_light[y1 * m_width + x0] * (1 - fx) + m_light[y1 * m_width + x1] * fx;
+	return (top * (1 - fy) + bottom * fy) / 255.f;
+}
+
+bool TorchLightmap::load(const std::string& path, uint64_t hash)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == nullptr)
+		return false;
+
+	uint32_t magic = 0;
+	uint64_t file_hash = 0;
+	int32_t size[2] = { 0, 0 };
+	bool valid = fread(&magic, sizeof(magic), 1, file) == 1 && magic == FILE_MAGIC &&
+				 fread(&file_hash, sizeof(file_hash), 1, file) == 1 && file_hash == hash &&
+				 fread(size, sizeof(size), 1, file) == 1 && size[0] > 0 && size[1] > 0;
+
+	if (valid)
+	{
+		m_light.resize(size[0] * size[1]);
+		valid = fread(m_light.data(), 1, m_light.size(), file) == m_light.size();
+	}
+	fclose(file);
+
+	if (!valid)
+	{
+		m_light.clear();
+		m_width = m_height = 0;
+		return false;
+	}
+
+	m_width = size[0];
+	m_height = size[1];
+	return true;
+}
+
+bool TorchLightmap::save(const std::string& path, uint64_t hash) const
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+
+	int32_t size[2] = { m_width, m_height };
+	bool written = fwrite(&FILE_MAGIC, sizeof(FILE_MAGIC), 1, file) == 1 &&
+				   fwrite(&hash, sizeof(hash), 1, file) == 1 &&
+				   fwrite(size, sizeof(size), 1, file) == 1 &&
+				   fwrite(m_light.data(), 1, m_light.size(), file) == m_light.size();
+
+	return fclose(file) == 0 && written;
+}
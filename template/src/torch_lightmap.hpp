@@ -0,0 +1,41 @@
+#pragma once
+
+#include "common.hpp"
+#include "distance_field.hpp"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Combined light of every torch in a level, baked once as torches never move. Sampled on a grid of
+// TEXEL_SIZE pixel texels covering the level from the top left corner of its first brick, like DistanceField.
+class TorchLightmap
+{
+public:
+	static const int TEXELS_PER_BRICK = 4;
+	static const float TEXEL_SIZE;
+	// Furthest a torch lights
+	static const float RANGE;
+
+	// Hash of a level's source, a baked lightmap is only reused for the level it was baked from
+	static uint64_t content_hash(const std::string& level_source);
+
+	// width and height in bricks, occlusion is traced through field
+	void bake(const DistanceField& field, const std::vector<vec2>& torches, int width, int height);
+
+	// Cache next to the level, load fails when the file is missing or was baked from other content
+	bool load(const std::string& path, uint64_t hash);
+	bool save(const std::string& path, uint64_t hash) const;
+
+	int get_width() const { return m_width; }
+	int get_height() const { return m_height; }
+	const uint8_t* data() const { return m_light.data(); }
+
+	// Bilinear lookup at a pixel position relative to the level, as the texture uploaded by Light is filtered
+	float sample(float x, float y) const;
+
+private:
+	int m_width = 0;
+	int m_height = 0;
+	std::vector<uint8_t> m_light; // row major, m_width x m_height, 255 is full brightness
+};
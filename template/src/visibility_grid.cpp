@@ -0,0 +1,160 @@
+#include "visibility_grid.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+	// One cell covers the default 1200x800 view, queries work for any view size
+	const float CELL_WIDTH = 1200.f;
+	const float CELL_HEIGHT = 800.f;
+
+	// Queries grow by this much so sprites centred just off screen are still found,
+	// entities reaching further than this from their position are returned by every query
+	const float MARGIN = 256.f;
+}
+
+uint64_t VisibilityGrid::cell_of(vec2 position) const
+{
+	int32_t x = (int32_t)std::floor(position.x / CELL_WIDTH);
+	int32_t y = (int32_t)std::floor(position.y / CELL_HEIGHT);
+	return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
+}
+
+float VisibilityGrid::extent_of(const RenderComponent* rc, const MotionComponent* mc)
+{
+	// Half diagonal, covers any rotation
+	vec2 half = { rc->size.x * std::abs(mc->physics.scale.x) / 2.f, rc->size.y * std::abs(mc->physics.scale.y) / 2.f };
+	return len(half);
+}
+
+bool VisibilityGrid::within(vec2 position, float extent, vec2 top_left, vec2 bottom_right)
+{
+	return position.x + extent >= top_left.x && position.x - extent <= bottom_right.x &&
+		   position.y + extent >= top_left.y && position.y - extent <= bottom_right.y;
+}
+
+void VisibilityGrid::insert(int entity, const RenderComponent* rc, const MotionComponent* mc)
+{
+	remove(entity);
+
+	Entry entry;
+	entry.rc = rc;
+	entry.mc = mc;
+	entry.cell = cell_of(mc->position);
+	entry.extent = extent_of(rc, mc);
+	entry.is_static = rc->is_static;
+	entry.is_large = entry.extent > MARGIN;
+	m_entries[entity] = entry;
+
+	if (entry.is_large)
+		m_large.push_back(entity);
+	else
+		m_cells[entry.cell].push_back(entity);
+
+	if (!entry.is_static)
+		m_dynamic.push_back(entity);
+}
+
+void VisibilityGrid::erase_from_cell(uint64_t cell, int entity)
+{
+	auto it = m_cells.find(cell);
+	if (it == m_cells.end())
+		return;
+
+	std::vector<int>& entities = it->second;
+	auto found = std::find(entities.begin(), entities.end(), entity);
+	if (found != entities.end())
+	{
+		*found = entities.back();
+		entities.pop_back();
+	}
+}
+
+void VisibilityGrid::remove(int entity)
+{
+	auto it = m_entries.find(entity);
+	if (it == m_entries.end())
+		return;
+
+	const Entry& entry = it->second;
+	if (entry.is_large)
+		m_large.erase(std::find(m_large.begin(), m_large.end(), entity));
+	else
+		erase_from_cell(entry.cell, entity);
+
+	if (!entry.is_static)
+		m_dynamic.erase(std::find(m_dynamic.begin(), m_dynamic.end(), entity));
+
+	m_entries.erase(it);
+}
+
+void VisibilityGrid::update()
+{
+	for (int entity : m_dynamic)
+	{
+		Entry& entry = m_entries[entity];
+
+		// Scale changes (robot flying) can move an entity in or out of the large list
+		float extent = extent_of(entry.rc, entry.mc);
+		bool is_large = extent > MARGIN;
+		uint64_t cell = cell_of(entry.mc->position);
+		entry.extent = extent;
+
+		if (is_large == entry.is_large && (is_large || cell == entry.cell))
+			continue;
+
+		if (entry.is_large)
+			m_large.erase(std::find(m_large.begin(), m_large.end(), entity));
+		else
+			erase_from_cell(entry.cell, entity);
+
+		if (is_large)
+			m_large.push_back(entity);
+		else
+			m_cells[cell].push_back(entity);
+
+		entry.cell = cell;
+		entry.is_large = is_large;
+	}
+}
+
+void VisibilityGrid::clear()
+{
+	m_cells.clear();
+	m_entries.clear();
+	m_dynamic.clear();
+	m_large.clear();
+}
+
+void VisibilityGrid::query(vec2 top_left, vec2 bottom_right, std::vector<int>& out) const
+{
+	for (int entity : m_large)
+	{
+		const Entry& entry = m_entries.at(entity);
+		if (within(entry.mc->position, entry.extent, top_left, bottom_right))
+			out.push_back(entity);
+	}
+
+	int32_t min_x = (int32_t)std::floor((top_left.x - MARGIN) / CELL_WIDTH);
+	int32_t max_x = (int32_t)std::floor((bottom_right.x + MARGIN) / CELL_WIDTH);
+	int32_t min_y = (int32_t)std::floor((top_left.y - MARGIN) / CELL_HEIGHT);
+	int32_t max_y = (int32_t)std::floor((bottom_right.y + MARGIN) / CELL_HEIGHT);
+
+	for (int32_t x = min_x; x <= max_x; ++x)
+	{
+		for (int32_t y = min_y; y <= max_y; ++y)
+		{
+			auto it = m_cells.find(((uint64_t)(uint32_t)x << 32) | (uint32_t)y);
+			if (it == m_cells.end())
+				continue;
+
+			for (int entity : it->second)
+			{
+				const Entry& entry = m_entries.at(entity);
+				if (within(entry.mc->position, entry.extent, top_left, bottom_right))
+					out.push_back(entity);
+			}
+		}
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "components.hpp"
+
+// Buckets entities into screen sized cells by position so culling only visits the cells around the camera.
+// Static entities are bucketed once, dynamic ones are re-bucketed by update() when they cross into another cell.
+class VisibilityGrid
+{
+public:
+	void insert(int entity, const RenderComponent* rc, const MotionComponent* mc);
+	void remove(int entity);
+	void update();
+	void clear();
+
+	// Appends every entity whose position lies in the rectangle grown by its extent
+	void query(vec2 top_left, vec2 bottom_right, std::vector<int>& out) const;
+
+	// Half diagonal of the entity's sprite, covers any rotation
+	static float extent_of(const RenderComponent* rc, const MotionComponent* mc);
+
+private:
+	struct Entry
+	{
+		const RenderComponent* rc;
+		const MotionComponent* mc;
+		uint64_t cell;
+		float extent;
+		bool is_static;
+		bool is_large;
+	};
+
+	uint64_t cell_of(vec2 position) const;
+	void erase_from_cell(uint64_t cell, int entity);
+	static bool within(vec2 position, float extent, vec2 top_left, vec2 bottom_right);
+
+	std::unordered_map<uint64_t, std::vector<int>> m_cells;
+	std::unordered_map<int, Entry> m_entries;
+	std::vector<int> m_dynamic;
+	std::vector<int> m_large;
+};
@@ -1,6 +1,7 @@
 // Header
 #include "world.hpp"
 #include "level.hpp"
+#include "gl_debug.hpp"
 
 // stlib
 #include <cassert>
@@ -39,7 +40,7 @@ bool World::init(GLFWwindow* window, vec2 screen)
 	// Create a frame buffer
 	m_frame_buffer = 0;
 	glGenFramebuffers(1, &m_frame_buffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, m_frame_buffer);
+	gl_bind_framebuffer(GL_FRAMEBUFFER, m_frame_buffer);
 
 	// For some high DPI displays (ex. Retina Display on Macbooks)
 	// https://stackoverflow.com/questions/36672935/why-retina-screen-coordinate-value-is-twice-the-value-of-pixel-value
@@ -123,7 +124,7 @@ void World::draw()
 
 	/////////////////////////////////////
 	// First render to the custom framebuffer
-	glBindFramebuffer(GL_FRAMEBUFFER, m_frame_buffer);
+	gl_bind_framebuffer(GL_FRAMEBUFFER, m_frame_buffer);
 
 	// Clearing backbuffer
 	glViewport(0, 0, w, h);
@@ -150,11 +151,11 @@ void World::draw()
 	// TODO: to fix lulus screen
 	vec2 camera_shift = { right / 2.f - camera_pos.x, bottom / 2.f - camera_pos.y };
 
-	m_level.draw_entities(projection_2D, camera_shift);
+	m_level.draw_entities(projection_2D, camera_shift, { right, bottom });
 
 	/////////////////////
 	// Truely render to the screen
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	gl_bind_framebuffer(GL_FRAMEBUFFER, 0);
 
 	// Clearing backbuffer
 	glViewport(0, 0, w, h);
@@ -165,7 +166,7 @@ void World::draw()
 
 	// Bind our texture in Texture Unit 0
 	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, m_screen_tex.id);
+	gl_bind_texture(GL_TEXTURE_2D, m_screen_tex.id);
 
 	m_level.draw_light(projection_2D, camera_shift);
 	//////////////////